@@ -0,0 +1,145 @@
+#ifndef ZEBRA_GO_ENGINE_BIT_BOARD_H_
+#define ZEBRA_GO_ENGINE_BIT_BOARD_H_
+
+#include <cstdint>
+
+#include <glog/logging.h>
+
+namespace zebra_go {
+
+// A fixed-width set of board cells, one bit per cell. Cells are identified by
+// their index in GoBoard's padded layout. All set operations work on whole
+// 64-bit words, so union, count and "first element" cost a handful of
+// instructions instead of a tree walk.
+template <int kNumWords>
+class BitBoard {
+ public:
+  static constexpr int kNumBits = kNumWords * 64;
+
+  BitBoard() { Clear(); }
+
+  void Clear() {
+    for (int i = 0; i < kNumWords; ++i) words_[i] = 0;
+  }
+
+  void Set(int idx) {
+    DCHECK(idx >= 0 && idx < kNumBits);
+    words_[idx >> 6] |= (uint64_t{1} << (idx & 63));
+  }
+
+  void Reset(int idx) {
+    DCHECK(idx >= 0 && idx < kNumBits);
+    words_[idx >> 6] &= ~(uint64_t{1} << (idx & 63));
+  }
+
+  bool Test(int idx) const {
+    DCHECK(idx >= 0 && idx < kNumBits);
+    return (words_[idx >> 6] >> (idx & 63)) & 1;
+  }
+
+  bool Empty() const {
+    uint64_t any = 0;
+    for (int i = 0; i < kNumWords; ++i) any |= words_[i];
+    return any == 0;
+  }
+
+  // Number of cells in the set.
+  int Count() const {
+    int n = 0;
+    for (int i = 0; i < kNumWords; ++i) n += __builtin_popcountll(words_[i]);
+    return n;
+  }
+
+  // Returns true if the set has exactly one cell.
+  bool IsSingleton() const {
+    int i = 0;
+    while (i < kNumWords && words_[i] == 0) ++i;
+    if (i == kNumWords || (words_[i] & (words_[i] - 1)) != 0) return false;
+    for (++i; i < kNumWords; ++i) {
+      if (words_[i] != 0) return false;
+    }
+    return true;
+  }
+
+  // Returns the smallest cell in the set, or -1 if the set is empty.
+  int First() const {
+    for (int i = 0; i < kNumWords; ++i) {
+      if (words_[i] != 0) return (i << 6) + __builtin_ctzll(words_[i]);
+    }
+    return -1;
+  }
+
+  // Runs f(idx) for every cell in the set, in increasing order.
+  template <typename F>
+  void ForEach(F f) const {
+    for (int i = 0; i < kNumWords; ++i) {
+      uint64_t w = words_[i];
+      while (w != 0) {
+        f((i << 6) + __builtin_ctzll(w));
+        w &= w - 1;
+      }
+    }
+  }
+
+  BitBoard& operator|=(const BitBoard& other) {
+    for (int i = 0; i < kNumWords; ++i) words_[i] |= other.words_[i];
+    return *this;
+  }
+
+  BitBoard& operator&=(const BitBoard& other) {
+    for (int i = 0; i < kNumWords; ++i) words_[i] &= other.words_[i];
+    return *this;
+  }
+
+  // Removes the cells of "other" from this set.
+  BitBoard& AndNot(const BitBoard& other) {
+    for (int i = 0; i < kNumWords; ++i) words_[i] &= ~other.words_[i];
+    return *this;
+  }
+
+  // Moves every cell up by n, i.e. cell i becomes cell i + n. Cells shifted
+  // past the end are dropped. n must be in (0, 64).
+  BitBoard& operator<<=(int n) {
+    DCHECK(n > 0 && n < 64);
+    for (int i = kNumWords - 1; i > 0; --i) {
+      words_[i] = (words_[i] << n) | (words_[i - 1] >> (64 - n));
+    }
+    words_[0] <<= n;
+    return *this;
+  }
+
+  // Moves every cell down by n, i.e. cell i becomes cell i - n. n must be in
+  // (0, 64).
+  BitBoard& operator>>=(int n) {
+    DCHECK(n > 0 && n < 64);
+    for (int i = 0; i < kNumWords - 1; ++i) {
+      words_[i] = (words_[i] >> n) | (words_[i + 1] << (64 - n));
+    }
+    words_[kNumWords - 1] >>= n;
+    return *this;
+  }
+
+  bool Intersects(const BitBoard& other) const {
+    uint64_t any = 0;
+    for (int i = 0; i < kNumWords; ++i) any |= words_[i] & other.words_[i];
+    return any != 0;
+  }
+
+  bool operator==(const BitBoard& other) const {
+    for (int i = 0; i < kNumWords; ++i) {
+      if (words_[i] != other.words_[i]) return false;
+    }
+    return true;
+  }
+  bool operator!=(const BitBoard& other) const { return !(*this == other); }
+
+  uint64_t word(int i) const { return words_[i]; }
+  uint64_t* mutable_words() { return words_; }
+
+ private:
+  uint64_t words_[kNumWords];
+};
+
+}  // namespace zebra_go
+
+#endif  // ZEBRA_GO_ENGINE_BIT_BOARD_H_
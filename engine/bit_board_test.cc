@@ -0,0 +1,73 @@
+#include "engine/bit_board.h"
+
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace zebra_go {
+namespace {
+
+using ::testing::ElementsAre;
+
+TEST(BitBoardTest, SetOperations) {
+  BitBoard<3> a;
+  EXPECT_TRUE(a.Empty());
+  EXPECT_EQ(-1, a.First());
+  EXPECT_FALSE(a.IsSingleton());
+
+  a.Set(70);
+  EXPECT_TRUE(a.IsSingleton());
+  EXPECT_EQ(70, a.First());
+
+  a.Set(3);
+  a.Set(191);
+  EXPECT_FALSE(a.IsSingleton());
+  EXPECT_EQ(3, a.Count());
+  EXPECT_EQ(3, a.First());
+  EXPECT_TRUE(a.Test(191));
+  EXPECT_FALSE(a.Test(190));
+
+  BitBoard<3> b;
+  b.Set(3);
+  b.Set(100);
+  EXPECT_TRUE(a.Intersects(b));
+
+  BitBoard<3> c = a;
+  c |= b;
+  std::vector<int> cells;
+  c.ForEach([&cells](int idx) { cells.push_back(idx); });
+  EXPECT_THAT(cells, ElementsAre(3, 70, 100, 191));
+
+  c.AndNot(a);
+  EXPECT_TRUE(c.IsSingleton());
+  EXPECT_EQ(100, c.First());
+
+  a &= b;
+  EXPECT_TRUE(a.IsSingleton());
+  a.Reset(3);
+  EXPECT_TRUE(a.Empty());
+}
+
+TEST(BitBoardTest, Shifts) {
+  BitBoard<3> a;
+  a.Set(0);
+  a.Set(62);
+  a.Set(150);
+  a.Set(191);
+
+  BitBoard<3> up = a;
+  up <<= 5;
+  std::vector<int> cells;
+  up.ForEach([&cells](int idx) { cells.push_back(idx); });
+  EXPECT_THAT(cells, ElementsAre(5, 67, 155));
+
+  BitBoard<3> down = a;
+  down >>= 63;
+  cells.clear();
+  down.ForEach([&cells](int idx) { cells.push_back(idx); });
+  EXPECT_THAT(cells, ElementsAre(87, 128));
+}
+
+}  // namespace
+}  // namespace zebra_go
@@ -1,5 +1,7 @@
 #include "engine/go_engine.h"
 
+#include <algorithm>
+#include <thread>
 #include <tuple>
 
 #include "absl/memory/memory.h"
@@ -8,6 +10,12 @@
 #include "glog/logging.h"
 
 DEFINE_bool(simple_scorer, false, "Use SimpleScorer or TfScorer.");
+DEFINE_int32(num_playouts, 0,
+             "If positive, use PlayoutScorer with this many playouts per "
+             "position instead of TfScorer.");
+DEFINE_double(playout_komi, 7.5, "Komi of the games PlayoutScorer plays.");
+DEFINE_int32(mcts_threads, 0,
+             "Number of search threads of MctsEngine. 0 for one per core.");
 
 namespace zebra_go {
 namespace {
@@ -16,6 +24,10 @@ std::unique_ptr<AsyncScorer> CreateScorerFromFlags() {
   if (FLAGS_simple_scorer) {
     LOG(INFO) << "Use the simplest scorer in SimpleEngine.";
     return absl::make_unique<SimpleScorer>();
+  } else if (FLAGS_num_playouts > 0) {
+    LOG(INFO) << "Use the playout scorer in SimpleEngine.";
+    return absl::make_unique<PlayoutScorer>(FLAGS_num_playouts,
+                                            FLAGS_playout_komi);
   } else {
     LOG(INFO) << "Use the DNN scorer in SimpleEngine.";
     return TfScorer::CreateFromFlags();
@@ -29,7 +41,7 @@ void GoEngine::SetBoardSize(GoSizeT size) {
 }
 
 void GoEngine::SetKomi(float komi) {
-  LOG(WARNING) << "Not implemented.";
+  komi_ = komi;
 }
 
 void GoEngine::ClearBoard() {
@@ -54,8 +66,18 @@ void GoEngine::Play(GoColor player, GoPosition move) {
   VLOG(1) << "After: \n " << board_->DebugString(/*output_chains=*/true);
 }
 
+float GoEngine::FinalScore() const {
+  CHECK(board_ != nullptr);
+  return board_->FinalScore(komi_);
+}
+
 SimpleEngine::SimpleEngine() : scorer_(CreateScorerFromFlags()) {}
 
+void SimpleEngine::SetKomi(float komi) {
+  GoEngine::SetKomi(komi);
+  scorer_->SetKomi(komi);
+}
+
 GoPosition SimpleEngine::GenMove(GoColor player) {
   CHECK(board_ != nullptr);
   CHECK(scorer_ != nullptr);
@@ -90,9 +112,18 @@ GoPosition SimpleEngine::GenMove(GoColor player) {
 MctsEngine::MctsEngine() : scorer_(CreateScorerFromFlags()) {}
 MctsEngine::~MctsEngine() {}
 
+void MctsEngine::SetKomi(float komi) {
+  GoEngine::SetKomi(komi);
+  scorer_->SetKomi(komi);
+}
+
 GoPosition MctsEngine::GenMove(GoColor player) {
+  int num_threads = FLAGS_mcts_threads;
+  if (num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
   auto tree = absl::make_unique<MonteCarloSearchTree>(
-    board_->Clone(), /*num_threads=*/16, scorer_.get());
+    board_->Clone(), num_threads, scorer_.get());
   auto result = tree->Search(/*time_limit=*/absl::Seconds(1));
   LOG(INFO) << result.DebugString();
   // Note that the result's first move can be kMoveResign.
@@ -25,8 +25,14 @@ class GoEngine {
   // if current player wants to pass or resign.
   virtual GoPosition GenMove(GoColor player) = 0;
 
+  // Black's lead by area scoring, komi included. Dead stones only count as
+  // such in areas settled by Benson's algorithm, see GoBoard::FinalScore.
+  float FinalScore() const;
+
  protected:
   std::unique_ptr<GoBoard> board_;
+  // Points added to white's area.
+  float komi_ = 7.5;
 };
 
 // A simple implementation of GoEngine for testing.
@@ -35,6 +41,7 @@ class SimpleEngine : public GoEngine {
   SimpleEngine();
   ~SimpleEngine() override {}
 
+  void SetKomi(float komi) override;
   GoPosition GenMove(GoColor player) override;
 
  private:
@@ -47,6 +54,7 @@ class MctsEngine : public GoEngine {
   MctsEngine();
   ~MctsEngine();
 
+  void SetKomi(float komi) override;
   GoPosition GenMove(GoColor player) override;
 
  private:
@@ -1,23 +1,22 @@
 #include "engine/go_game.h"
 
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
 #include <string>
+#include <type_traits>
 
 #include "absl/memory/memory.h"
 #include "absl/strings/ascii.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
+#include "engine/tactics.h"
 
 namespace zebra_go {
 
 using absl::StrAppend;
 
-const int16_t INVALID_ID = 0;
-const int16_t MIN_CHAIN_ID = 1000;
-const int16_t MAX_CHAIN_ID = 3000;
-const int16_t MIN_AREA_ID = 10000;
-const int16_t MAX_AREA_ID = 20000;
-
 std::string ToString(GoPosition pos) {
   if (pos.first == kNPos.first) return "unset";
   if (pos.first == kMovePass.first) return "pass";
@@ -77,438 +76,862 @@ GoColor GetOpponent(GoColor s) {
   return COLOR_NONE;
 }
 
-static const size_t kNumFeaturePlanes = 7;
+namespace {
+
+// Random keys for Zobrist hashing. They are generated from a fixed seed, so
+// hashes are stable across runs and processes.
+struct ZobristKeys {
+  // stone[color][cell]. The COLOR_NONE row is used for the ko point.
+  uint64_t stone[3][kMaxNumCells];
+  uint64_t white_to_move;
+};
+
+const ZobristKeys& GetZobristKeys() {
+  static const ZobristKeys* keys = [] {
+    auto* k = new ZobristKeys();
+    uint64_t state = 0x5a65627261476f21ULL;
+    auto next = [&state]() {  // SplitMix64.
+      uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    };
+    for (int c = 0; c < 3; ++c) {
+      for (int i = 0; i < kMaxNumCells; ++i) {
+        k->stone[c][i] = next();
+      }
+    }
+    k->white_to_move = next();
+    return k;
+  }();
+  return *keys;
+}
+
+// The floats of every packed cell value, padded to 8 floats per row.
+struct FeatureExpansionTable {
+  float values[256][8];
+};
+
+constexpr FeatureExpansionTable MakeFeatureExpansionTable() {
+  FeatureExpansionTable table{};
+  for (int cell = 0; cell < 256; ++cell) {
+    for (int pid = 0; pid < GoFeatureSet::kNumPlanes; ++pid) {
+      table.values[cell][pid] = (cell >> pid) & 1;
+    }
+    if (cell & GoFeatureSet::kNegativeOrig) table.values[cell][0] -= 1;
+  }
+  return table;
+}
+
+constexpr FeatureExpansionTable kFeatureExpansionTable =
+    MakeFeatureExpansionTable();
+
+}  // namespace
+
+constexpr int GoFeatureSet::kNumPlanes;
+constexpr int GoFeatureSet::kNumTacticalPlanes;
+constexpr int GoFeatureSet::kMaxHistory;
+constexpr uint8_t GoFeatureSet::kNegativeOrig;
 
 std::string GoFeatureSet::GetPlaneName(int idx) const {
   static const char* kPlaneNames[] = {
     "orig", "b1", "b2", "b3", "w1", "w2", "w3",
   };
+  static const char* kTacticalPlaneNames[] = {"capture", "escape"};
+  if (idx >= history_plane_base()) {
+    const int bit = idx - history_plane_base();
+    return absl::StrCat(bit % 2 == 0 ? "b" : "w", "_hist", bit / 2 + 1);
+  }
+  if (idx >= kNumPlanes) return kTacticalPlaneNames[idx - kNumPlanes];
   return kPlaneNames[idx];
 }
 
-GoFeatureSet::GoFeatureSet(GoSizeT width, GoSizeT height)
-    : width_(width), height_(height), planes_(kNumFeaturePlanes) {
-  for (size_t i = 0; i < planes_.size(); ++i) {
-    planes_[i].resize(width_ * height_);
+GoFeatureSet::GoFeatureSet(GoSizeT width, GoSizeT height, bool tactical_planes,
+                           int num_history)
+    : width_(width), height_(height), num_history_(num_history),
+      cells_(width_ * height_),
+      tactical_cells_(tactical_planes ? width_ * height_ : 0),
+      history_cells_(num_history > 0 ? width_ * height_ : 0) {
+  CHECK(num_history >= 0 && num_history <= kMaxHistory) << num_history;
+}
+
+void GoFeatureSet::ExpandTo(float* output) const {
+  static_assert(kNumPlanes < 8, "A table row must cover all planes.");
+  static_assert(kNumPlanes + kNumTacticalPlanes >= 8 && kNumPlanes + 2 >= 8,
+                "A table row must fit in a cell with more planes.");
+  const int num_cells = cells_.size();
+  if (num_cells == 0) return;
+  const int num_planes = this->num_planes();
+  if (num_planes > kNumPlanes) {
+    const int num_history_planes = 2 * num_history_;
+    for (int i = 0; i < num_cells; ++i) {
+      float* cell = output + i * num_planes;
+      std::memcpy(cell, kFeatureExpansionTable.values[cells_[i]],
+                  8 * sizeof(float));
+      float* extra = cell + kNumPlanes;
+      if (has_tactical_planes()) {
+        for (int t = 0; t < kNumTacticalPlanes; ++t) {
+          *extra++ = (tactical_cells_[i] >> t) & 1;
+        }
+      }
+      for (int h = 0; h < num_history_planes; ++h) {
+        *extra++ = (history_cells_[i] >> h) & 1;
+      }
+    }
+    return;
+  }
+  // Copies whole 8-float table rows, which the compiler turns into two
+  // 16-byte vector moves per cell. The extra float lands on the first plane
+  // of the next cell and is overwritten right after.
+  for (int i = 0; i + 1 < num_cells; ++i) {
+    std::memcpy(output + i * kNumPlanes,
+                kFeatureExpansionTable.values[cells_[i]], 8 * sizeof(float));
   }
+  std::memcpy(output + (num_cells - 1) * kNumPlanes,
+              kFeatureExpansionTable.values[cells_[num_cells - 1]],
+              kNumPlanes * sizeof(float));
+}
+
+std::vector<float> GoFeatureSet::plane(int idx) const {
+  std::vector<float> values(cells_.size());
+  if (idx >= history_plane_base()) {
+    for (size_t i = 0; i < values.size(); ++i) {
+      values[i] = (history_cells_[i] >> (idx - history_plane_base())) & 1;
+    }
+    return values;
+  }
+  if (idx >= kNumPlanes) {
+    for (size_t i = 0; i < values.size(); ++i) {
+      values[i] = (tactical_cells_[i] >> (idx - kNumPlanes)) & 1;
+    }
+    return values;
+  }
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = kFeatureExpansionTable.values[cells_[i]][idx];
+  }
+  return values;
 }
 
 void GoFeatureSet::CopyFrom(const GoFeatureSet& other) {
   CHECK_EQ(width_, other.width_);
   CHECK_EQ(height_, other.height_);
-  CHECK_EQ(planes_.size(), other.planes_.size());
-  for (size_t i = 0; i < other.planes_.size(); ++i) {
-    planes_[i] = other.planes_[i];
-  }
+  CHECK_EQ(has_tactical_planes(), other.has_tactical_planes());
+  CHECK_EQ(num_history_, other.num_history_);
+  cells_ = other.cells_;
+  tactical_cells_ = other.tactical_cells_;
+  history_cells_ = other.history_cells_;
 }
 
-void GoFeatureSet::Reset() {
-  for (size_t i = 0; i < planes_.size(); ++i) {
-    std::fill(planes_[i].begin(), planes_[i].end(), 0.0f);
+void GoFeatureSet::Set(int plane_id, GoSizeT x, GoSizeT y, float value) {
+  DCHECK(plane_id >= 0 && plane_id < num_planes());
+  DCHECK(value == 0 || value == 1 || (plane_id == 0 && value == -1));
+  if (plane_id >= history_plane_base()) {
+    const uint8_t bit = 1 << (plane_id - history_plane_base());
+    uint8_t& bits = history_cells_[y * width_ + x];
+    bits = value > 0 ? (bits | bit) : (bits & ~bit);
+    return;
+  }
+  if (plane_id >= kNumPlanes) {
+    const uint8_t bit = 1 << (plane_id - kNumPlanes);
+    uint8_t& flags = tactical_cells_[y * width_ + x];
+    flags = value > 0 ? (flags | bit) : (flags & ~bit);
+    return;
+  }
+  uint8_t& cell = cells_[y * width_ + x];
+  const uint8_t mask = (1 << plane_id) | (plane_id == 0 ? kNegativeOrig : 0);
+  cell &= ~mask;
+  if (value > 0) {
+    cell |= 1 << plane_id;
+  } else if (value < 0) {
+    cell |= kNegativeOrig;
   }
 }
 
-GoBoard::NeighorIterator::NeighorIterator(const GoBoard* b, GoPosition c)
-    : board(b), center(c), offset(-1) {
-  ++(*this);
-};
+void GoFeatureSet::Negate(int plane_id) {
+  CHECK_EQ(0, plane_id) << "Only orig has negative values.";
+  SwapBits(0, 7);
+}
 
-GoBoard::NeighorIterator& GoBoard::NeighorIterator::operator++() {
-  static const std::pair<GoSizeT, GoSizeT> kDeltas[] = {
-      {0, -1}, {0, 1}, {-1, 0}, {1, 0}
-  };
-  CHECK(!end()) << "Trying to advance after reaching the end.";
-  ++offset;
-  for (; offset < 4; ++offset) {
-    current = std::make_pair(center.first + kDeltas[offset].first,
-                             center.second + kDeltas[offset].second);
-    if (board->IsValidPosition(current)) {
-      return *this;
-    }
+void GoFeatureSet::SwapPlanes(int a, int b) {
+  CHECK(a > 0 && a < kNumPlanes && b > 0 && b < kNumPlanes);
+  SwapBits(a, b);
+}
+
+void GoFeatureSet::SwapBits(int a, int b) {
+  for (uint8_t& cell : cells_) {
+    const uint8_t differ = ((cell >> a) ^ (cell >> b)) & 1;
+    cell ^= (differ << a) | (differ << b);
   }
-  return *this;
 }
 
-GoBoard::GoBoard(GoSizeT width, GoSizeT height)
-    : width_(width), height_(height), current_player_(COLOR_BLACK),
-      next_chain_id_(INVALID_ID + 1), ko_(kNPos) {
+void GoFeatureSet::Reset() {
+  std::fill(cells_.begin(), cells_.end(), 0);
+  std::fill(tactical_cells_.begin(), tactical_cells_.end(), 0);
+  std::fill(history_cells_.begin(), history_cells_.end(), 0);
+}
+
+template <int N>
+constexpr int GoBoardT<N>::kNumCells;
+template <int N>
+constexpr int GoBoardT<N>::kMaxNumChains;
+template <int N>
+constexpr typename GoBoardT<N>::Index GoBoardT<N>::kNoCell;
+template <int N>
+constexpr int16_t GoBoardT<N>::kNoChain;
+
+template <int N>
+GoBoardT<N>::GoBoardT(GoSizeT width, GoSizeT height)
+    : width_(width), height_(height), stride_(width + 2),
+      current_player_(COLOR_BLACK), ko_(kNoCell), hash_(0),
+      track_dirty_(false), track_patterns_(false),
+      num_chain_slots_(0), num_free_chain_ids_(0) {
+  static_assert(std::is_trivially_copyable<GoBoardT>::value,
+                "GoBoardT is copied with memcpy.");
+  static_assert(std::is_standard_layout<GoBoardT>::value,
+                "UsedBytes relies on offsetof.");
   CHECK_GT(width_, 0);
   CHECK_GT(height_, 0);
-  stones_.resize(width_ * height_);
-  std::fill(stones_.begin(), stones_.end(), COLOR_NONE);
-
-  chains_.resize(width_ * height_);
-  std::fill(chains_.begin(), chains_.end(), INVALID_ID);
+  CHECK_LE(width_, kMaxBoardSize);
+  CHECK_LE(height_, kMaxBoardSize);
+  if (N > 0) {
+    CHECK_EQ(N, width_);
+    CHECK_EQ(N, height_);
+  }
 
-  features_ = absl::make_unique<GoFeatureSet>(width, height);
-  UpdateFeatureSet();
+  std::fill(std::begin(stones_), std::end(stones_), COLOR_OFF_BOARD);
+  for (GoSizeT y = 0; y < height_; ++y) {
+    const Index row = ToIndex({0, y});
+    std::fill(stones_ + row, stones_ + row + width_, COLOR_NONE);
+    for (Index idx = row; idx < row + width_; ++idx) {
+      empty_.Set(idx);
+    }
+  }
+  std::fill(std::begin(chain_ids_), std::end(chain_ids_), kNoChain);
+  std::fill(std::begin(patterns_), std::end(patterns_), 0);
+  std::fill(std::begin(atari_flags_), std::end(atari_flags_), 0);
 
-  approx_territory_.resize(3);
   approx_territory_[0] = width_ * height_;
   approx_territory_[1] = 0;
   approx_territory_[2] = 0;
 }
 
-std::unique_ptr<GoBoard> GoBoard::Clone() const {
-  auto c = absl::make_unique<GoBoard>(width_, height_);
-  c->current_player_ = current_player_;
-  c->stones_ = stones_;
-  c->chains_ = chains_;
-  for (const auto& iter : chain_map_) {
-    c->chain_map_.insert(std::make_pair(iter.first, iter.second->Clone()));
-  }
-  c->next_chain_id_ = next_chain_id_;
-  c->ko_ = ko_;
-  c->forbidden_positions_ = forbidden_positions_;
-  c->features_->CopyFrom(*features_);
-  c->approx_territory_ = approx_territory_;
-  return c;
+template <int N>
+size_t GoBoardT<N>::UsedBytes() const {
+  return offsetof(GoBoardT, chains_) +
+         (num_chain_slots_ + 1) * sizeof(Chain);
 }
 
-bool GoBoard::IsLegalMove(GoPosition move) const {
-  if (move == kMovePass || move == kMoveResign) {
-    return true;
-  }
-  if (!IsValidPosition(move)) {  // Out of the board's boundary.
-    return false;
-  }
-  if (GetStone(move) != COLOR_NONE) {  // The new position is occupied.
-    return false;
-  }
-  if (ko_ != kNPos && move == ko_) {
-    return false;
-  }
-  if (forbidden_positions_.find(move) != forbidden_positions_.end()) {
-    return false;
-  }
-  return true;
+template <int N>
+std::unique_ptr<GoBoardT<N>> GoBoardT<N>::Clone() const {
+  // The tail of the chain pool is never read before CreateNewChain
+  // initializes it, so it is left uninitialized in the copy.
+  void* copy = ::operator new(sizeof(GoBoardT));
+  std::memcpy(copy, this, UsedBytes());
+  return std::unique_ptr<GoBoardT>(static_cast<GoBoardT*>(copy));
 }
 
-// Dead stones of the opponent will be put to "dead".
-bool GoBoard::Move(GoPosition move, bool estimate_territory,
-                   std::vector<GoPosition>* captured_stones) {
-  if (!IsLegalMove(move)) {
-    return false;
+template <int N>
+uint64_t GoBoardT<N>::StonesHash() const {
+  const ZobristKeys& keys = GetZobristKeys();
+  uint64_t h = hash_;
+  if (current_player_ == COLOR_WHITE) {
+    h ^= keys.white_to_move;
   }
-  if (move == kMoveResign) {
-    return true;
+  if (ko_ != kNoCell) {
+    h ^= keys.stone[COLOR_NONE][ko_];
   }
-  if (move == kMovePass) {
-    current_player_ = GetOpponent(current_player_);
-    UpdateForbiddenPositions();
-    UpdateFeatureSet();
-    if (estimate_territory) {
-      EstimateTerritory();
+  return h;
+}
+
+template <int N>
+uint64_t GoBoardT<N>::StonesHashAfterMove(Index idx) const {
+  uint64_t h = StonesHash() ^ GetZobristKeys().stone[current_player_][idx];
+  AdjacentChains neighbors, opponents;
+  GetAdjacentChains(idx, &neighbors, &opponents, nullptr);
+  for (const Chain* chain : opponents) {
+    if (chain->HasOneLiberty()) {  // Its only liberty must be idx.
+      h ^= chain->hash;
     }
-    return true;
   }
+  return h;
+}
+
+template <int N>
+void GoBoardT<N>::SaveState(UndoRecord* undo) const {
+  undo->ko = ko_;
+  undo->hash = hash_;
+  std::copy(std::begin(approx_territory_), std::end(approx_territory_),
+            undo->approx_territory);
+  undo->forbidden[0] = forbidden_[0];
+  undo->forbidden[1] = forbidden_[1];
+  undo->num_chain_slots = num_chain_slots_;
+  undo->num_free_chain_ids = num_free_chain_ids_;
+  undo->new_chain_id = kNoChain;
+  undo->num_merged = 0;
+  undo->num_captured = 0;
+  undo->num_opponents = 0;
+}
+
+template <int N>
+void GoBoardT<N>::Pass(UndoRecord* undo) {
+  if (undo != nullptr) {
+    SaveState(undo);
+    undo->move = kNoCell;
+  }
+  current_player_ = GetOpponent(current_player_);
+  hash_ ^= GetZobristKeys().white_to_move;
+}
 
-  // We need to store dead stones when updating the board. So keep them in
-  // this vector even if the caller doesn't need them.
-  std::vector<GoPosition> deads;
-  if (captured_stones == nullptr) {
-    captured_stones = &deads;
+template <int N>
+void GoBoardT<N>::Play(Index idx, CellSet* captured, UndoRecord* undo) {
+  DCHECK(IsLegalMove(idx));
+  const ZobristKeys& keys = GetZobristKeys();
+  captured->Clear();
+  if (undo != nullptr) {
+    SaveState(undo);
+    undo->move = idx;
   }
-  captured_stones->clear();
 
   // Reset Ko
-  ko_ = kNPos;
+  if (ko_ != kNoCell) {
+    hash_ ^= keys.stone[COLOR_NONE][ko_];
+  }
+  ko_ = kNoCell;
 
-  // Remove captured chains.
-  std::set<GoChain*> neighbors;  // Adjacent chains of the same color.
-  std::set<GoChain*> opponents;  // Adjacent opponent chains.
-  std::vector<GoPosition> liberties;
-  GetAdjacentChains(move, &neighbors, &opponents, &liberties);
+  AdjacentChains neighbors;  // Adjacent chains of the same color.
+  AdjacentChains opponents;  // Adjacent opponent chains.
+  CellSet liberties;
+  GetAdjacentChains(idx, &neighbors, &opponents, &liberties);
+
+  // Cells whose forbidden state may change: the move, and the liberties of
+  // every chain whose stones or liberties change.
+  CellSet touched;
+  touched.Set(idx);
 
   // Move.
-  SetStone(move, current_player_);
+  stones_[idx] = current_player_;
+  empty_.Reset(idx);
+  player_stones_[current_player_ - 1].Set(idx);
+  hash_ ^= keys.stone[current_player_][idx];
 
   // Remove captured chains.
-  for (GoChain* chain : opponents) {
-    if (chain->liberties.size() == 1 && move == chain->FirstLiberty()) {
+  for (Chain* chain : opponents) {
+    if (chain->HasOneLiberty() && idx == chain->FirstLiberty()) {
       // This move captures the chain.
-      RemoveChain(chain, captured_stones);
+      if (undo != nullptr) {
+        undo->captured_ids[undo->num_captured] = chain - chains_;
+        undo->captured_chains[undo->num_captured++] = *chain;
+      }
+      RemoveChain(chain, captured);
     } else {  // Update the liberties of the other opponents.
-      chain->liberties.erase(move);
+      if (undo != nullptr) {
+        undo->opponent_ids[undo->num_opponents++] = chain - chains_;
+      }
+      chain->liberties.Reset(idx);
+      touched |= chain->liberties;
+      MarkDirty(chain->stones);
     }
   }
-  opponents.clear();
 
   // Merge neighbors or create a new chain.
-  GoChain* new_chain = nullptr;
+  Chain* new_chain = nullptr;
   if (neighbors.empty()) {
-    new_chain = CreateNewChain(move, liberties);
+    new_chain = CreateNewChain(idx, liberties);
   } else {
-    MergeChains(move, liberties, &neighbors);
+    if (undo != nullptr) {
+      for (Chain* chain : neighbors) {
+        undo->merged_ids[undo->num_merged] = chain - chains_;
+        undo->merged_chains[undo->num_merged++] = *chain;
+      }
+    }
+    MergeChains(idx, liberties, neighbors);
+  }
+  if (undo != nullptr) {
+    undo->new_chain_id = new_chain == nullptr ? kNoChain : new_chain - chains_;
   }
 
-  std::set<GoChain*> dummy;
-  for (GoPosition removed_stone : *captured_stones) {
-    std::set<GoChain*> touched_chains;
-    GetAdjacentChains(removed_stone, &touched_chains, &dummy, nullptr);
-    DCHECK(dummy.empty());
-    for (GoChain* chain : touched_chains) {
-      chain->liberties.insert(removed_stone);
+  // The removed stones become liberties of the chains around them, which
+  // all belong to current player. Those in atari get out of it, so the atari
+  // flags of their old liberty change.
+  CellSet atari_changes;
+  captured->ForEach([this, &touched, &atari_changes](Index removed_stone) {
+    for (const Index offset : neighbor_offsets()) {
+      const Index cur = removed_stone + offset;
+      if (StoneAt(cur) == current_player_) {
+        Chain* chain = MutableChain(cur);
+        if (track_patterns_ && chain->HasOneLiberty()) {
+          atari_changes.Set(chain->FirstLiberty());
+        }
+        chain->liberties.Set(removed_stone);
+        touched |= chain->liberties;
+        MarkDirty(chain->stones);
+      }
     }
-  }
+  });
+  touched |= GetChain(idx)->liberties;
+  touched |= *captured;
+  MarkDirty(*captured);
+  MarkDirty(GetChain(idx)->stones);
 
   // It is a ko if the ko position is the only liberty of the new stone.
-  if (captured_stones->size() == 1 && new_chain != nullptr &&
-      new_chain->liberties.size() == 1 &&
-      new_chain->FirstLiberty() == (*captured_stones)[0]) {
-    ko_ = (*captured_stones)[0];
+  if (new_chain != nullptr && captured->IsSingleton() &&
+      new_chain->HasOneLiberty() &&
+      new_chain->FirstLiberty() == captured->First()) {
+    ko_ = captured->First();
+    hash_ ^= keys.stone[COLOR_NONE][ko_];
+  }
+
+  if (track_patterns_) {
+    SetPatternColor(idx, current_player_);
+    atari_flags_[idx] = 0;
+    captured->ForEach([this](Index removed_stone) {
+      SetPatternColor(removed_stone, COLOR_NONE);
+    });
+    // Chains only get into atari by losing a liberty to the move: the
+    // opponents that are left and the chain of the move.
+    atari_changes |= *captured;
+    for (const Chain* chain : opponents) {
+      if (chain->color != COLOR_NONE && chain->HasOneLiberty()) {
+        atari_changes.Set(chain->FirstLiberty());
+      }
+    }
+    if (GetChain(idx)->HasOneLiberty()) {
+      atari_changes.Set(GetChain(idx)->FirstLiberty());
+    }
+    atari_changes.ForEach([this](Index cell) { UpdateAtariFlags(cell); });
   }
 
   // Done.
+  UpdateForbiddenPositions(touched);
   current_player_ = GetOpponent(current_player_);
-  UpdateForbiddenPositions();
-  UpdateFeatureSet();
-  if (estimate_territory) {
-    EstimateTerritory();
-  } else {
-    std::fill(approx_territory_.begin(), approx_territory_.end(), 0);
+  hash_ ^= keys.white_to_move;
+}
+
+template <int N>
+void GoBoardT<N>::Undo(const UndoRecord& undo) {
+  // The player who made the move.
+  current_player_ = GetOpponent(current_player_);
+
+  num_chain_slots_ = undo.num_chain_slots;
+  num_free_chain_ids_ = undo.num_free_chain_ids;
+  const Index idx = undo.move;
+  if (idx != kNoCell) {
+    // Free the new chain, or split the merged one. Slots may be reused by
+    // the captured chains below.
+    if (undo.new_chain_id != kNoChain) {
+      chains_[undo.new_chain_id].color = COLOR_NONE;
+    }
+    for (int i = 0; i < undo.num_merged; ++i) {
+      const int16_t chain_id = undo.merged_ids[i];
+      chains_[chain_id] = undo.merged_chains[i];
+      chains_[chain_id].stones.ForEach(
+          [this, chain_id](Index stone) { chain_ids_[stone] = chain_id; });
+      MarkDirty(chains_[chain_id].stones);
+    }
+    stones_[idx] = COLOR_NONE;
+    empty_.Set(idx);
+    player_stones_[current_player_ - 1].Reset(idx);
+    chain_ids_[idx] = kNoChain;
+    if (track_dirty_) {
+      dirty_.Set(idx);
+    }
+
+    for (int i = 0; i < undo.num_opponents; ++i) {
+      Chain* chain = &chains_[undo.opponent_ids[i]];
+      chain->liberties.Set(idx);
+      MarkDirty(chain->stones);
+    }
+
+    // Put the captured chains back. Their stones are not liberties of the
+    // chains around them anymore.
+    for (int i = 0; i < undo.num_captured; ++i) {
+      const int16_t chain_id = undo.captured_ids[i];
+      const Chain& chain = undo.captured_chains[i];
+      chains_[chain_id] = chain;
+      empty_.AndNot(chain.stones);
+      player_stones_[chain.color - 1] |= chain.stones;
+      chain.stones.ForEach([this, &chain, chain_id](Index stone) {
+        stones_[stone] = chain.color;
+        chain_ids_[stone] = chain_id;
+        for (const Index offset : neighbor_offsets()) {
+          const Index cur = stone + offset;
+          if (StoneAt(cur) == current_player_) {
+            Chain* neighbor = MutableChain(cur);
+            neighbor->liberties.Reset(stone);
+            MarkDirty(neighbor->stones);
+          }
+        }
+      });
+      MarkDirty(chain.stones);
+    }
+
+    // Restoring the count is not enough for the free list: without
+    // captures, the move took the last free id for its new chain, and later
+    // moves, since undone, may have written over that entry. Put the id back.
+    if (undo.new_chain_id != kNoChain && undo.num_captured == 0 &&
+        undo.new_chain_id <= num_chain_slots_) {
+      free_chain_ids_[num_free_chain_ids_ - 1] = undo.new_chain_id;
+    }
+  }
+
+  ko_ = undo.ko;
+  hash_ = undo.hash;
+  std::copy(std::begin(undo.approx_territory),
+            std::end(undo.approx_territory), approx_territory_);
+  forbidden_[0] = undo.forbidden[0];
+  forbidden_[1] = undo.forbidden[1];
+  if (track_patterns_) {
+    RebuildPatterns();
+  }
+}
+
+template <int N>
+void GoBoardT<N>::set_track_patterns(bool track) {
+  track_patterns_ = track;
+  if (track) {
+    RebuildPatterns();
+  }
+}
+
+template <int N>
+void GoBoardT<N>::SetPatternColor(Index idx, GoColor color) {
+  const auto offsets = pattern_offsets();
+  for (int i = 0; i < 8; ++i) {
+    // "idx" is cell 7 - i around its neighbor i.
+    uint16_t& pattern = patterns_[idx + offsets[i]];
+    const int shift = 2 * (7 - i);
+    pattern = (pattern & ~(3 << shift)) | (color << shift);
   }
-  return true;
 }
 
-GoBoard::GoChain* GoBoard::GetChain(GoPosition p) const {
-  DCHECK(IsValidPosition(p));
-  const int16_t chain_id = chains_[Encode(p)];
-  if (chain_id == INVALID_ID) return nullptr;
-  const auto iter = chain_map_.find(chain_id);
-  DCHECK(iter != chain_map_.end());
-  return iter->second.get();
+template <int N>
+void GoBoardT<N>::UpdateAtariFlags(Index idx) {
+  uint8_t flags = 0;
+  if (StoneAt(idx) == COLOR_NONE) {
+    const auto offsets = neighbor_offsets();
+    for (int i = 0; i < 4; ++i) {
+      const Chain* chain = GetChain(idx + offsets[i]);
+      if (chain != nullptr && chain->HasOneLiberty()) {
+        flags |= 1 << i;
+      }
+    }
+  }
+  atari_flags_[idx] = flags;
 }
 
-void GoBoard::GetAdjacentChains(GoPosition pos,
-                                std::set<GoChain*>* neighbors,
-                                std::set<GoChain*>* opponents,
-                                std::vector<GoPosition>* liberties) const {
-  for (NeighorIterator iter(this, pos); !iter.end(); ++iter) {
-    GoPosition cur = *iter;
-    if (GetStone(cur) == COLOR_NONE) {
+template <int N>
+void GoBoardT<N>::RebuildPatterns() {
+  const auto offsets = pattern_offsets();
+  for (GoSizeT y = 0; y < height(); ++y) {
+    const Index row = ToIndex({0, y});
+    for (Index idx = row; idx < row + width(); ++idx) {
+      uint16_t pattern = 0;
+      for (int i = 0; i < 8; ++i) {
+        pattern |= StoneAt(idx + offsets[i]) << (2 * i);
+      }
+      patterns_[idx] = pattern;
+      UpdateAtariFlags(idx);
+    }
+  }
+}
+
+template <int N>
+void GoBoardT<N>::GetAdjacentChains(Index idx, AdjacentChains* neighbors,
+                                      AdjacentChains* opponents,
+                                      CellSet* liberties) const {
+  for (const Index offset : neighbor_offsets()) {
+    const Index cur = idx + offset;
+    const GoColor color = StoneAt(cur);
+    if (color == COLOR_OFF_BOARD) continue;
+    if (color == COLOR_NONE) {
       if (liberties != nullptr) {
-        liberties->push_back(cur);
+        liberties->Set(cur);
       }
     } else {
-      GoChain* chain = GetChain(cur);
+      // The caller only gets const access to this board.
+      Chain* chain = const_cast<Chain*>(GetChain(cur));
       CHECK(chain != nullptr);
-      if (chain->color == this->current_player()) {
-        neighbors->insert(chain);
+      if (chain->color == current_player_) {
+        neighbors->Add(chain);
       } else {
-        opponents->insert(chain);
+        opponents->Add(chain);
       }
     }
   }
 }
 
-void GoBoard::RemoveChain(const GoChain* c,
-                          std::vector<GoPosition>* dead_stones) {
-  for (GoPosition stone : c->stones) {
-    dead_stones->emplace_back(stone);
-    SetChainId(stone, INVALID_ID);
-    SetStone(stone, COLOR_NONE);
-  }
-  chain_map_.erase(c->chain_id);
+template <int N>
+void GoBoardT<N>::RemoveChain(Chain* c, CellSet* deads) {
+  c->stones.ForEach([this](Index stone) {
+    chain_ids_[stone] = kNoChain;
+    stones_[stone] = COLOR_NONE;
+  });
+  *deads |= c->stones;
+  empty_ |= c->stones;
+  player_stones_[c->color - 1].AndNot(c->stones);
+  hash_ ^= c->hash;
+  c->color = COLOR_NONE;
+  free_chain_ids_[num_free_chain_ids_++] = c - chains_;
 }
 
-GoBoard::GoChain* GoBoard::CreateNewChain(
-    GoPosition stone, const std::vector<GoPosition>& liberties) {
-  auto chain = absl::make_unique<GoBoard::GoChain>(
-      current_player_, next_chain_id_++);
-  chain->stones.push_back(stone);
-  chain->liberties.insert(liberties.begin(), liberties.end());
-  SetChainId(stone, chain->chain_id);
-  auto* result = chain.get();
-  chain_map_.insert(std::make_pair(chain->chain_id, std::move(chain)));
-  return result;
+template <int N>
+typename GoBoardT<N>::Chain* GoBoardT<N>::CreateNewChain(
+    Index stone, const CellSet& liberties) {
+  const int16_t chain_id = num_free_chain_ids_ > 0
+                               ? free_chain_ids_[--num_free_chain_ids_]
+                               : ++num_chain_slots_;
+  DCHECK_LE(chain_id, kMaxNumChains);
+  Chain* chain = &chains_[chain_id];
+  chain->color = current_player_;
+  chain->stones.Clear();
+  chain->stones.Set(stone);
+  chain->liberties = liberties;
+  chain->hash = GetZobristKeys().stone[current_player_][stone];
+  chain_ids_[stone] = chain_id;
+  return chain;
 }
 
-void GoBoard::MergeChains(
-    GoPosition joint, const std::vector<GoPosition>& liberties,
-    std::set<GoChain*>* chains) {
-  DCHECK(!chains->empty());
-  std::set<GoChain*>::const_iterator iter = chains->begin();
-  GoChain* merged = *iter;
-  const int16_t cid = merged->chain_id;
+template <int N>
+void GoBoardT<N>::MergeChains(Index joint, const CellSet& liberties,
+                                const AdjacentChains& chains) {
+  DCHECK(!chains.empty());
+  Chain* const* iter = chains.begin();
+  Chain* merged = *iter;
+  const int16_t cid = merged - chains_;
 
-  for (++iter; iter != chains->end(); ++iter) {
-    GoChain* from = *iter;
-    for (GoPosition stone : from->stones) {
-      SetChainId(stone, cid);
-      merged->stones.push_back(stone);
-    }
-    merged->liberties.insert(from->liberties.begin(), from->liberties.end());
-    chain_map_.erase(from->chain_id);
+  for (++iter; iter != chains.end(); ++iter) {
+    Chain* from = *iter;
+    from->stones.ForEach([this, cid](Index stone) { chain_ids_[stone] = cid; });
+    merged->stones |= from->stones;
+    merged->liberties |= from->liberties;
+    merged->hash ^= from->hash;
+    from->color = COLOR_NONE;
+    free_chain_ids_[num_free_chain_ids_++] = from - chains_;
   }
-  merged->stones.push_back(joint);
-  SetChainId(joint, cid);
-  merged->liberties.erase(joint);
-  merged->liberties.insert(liberties.begin(), liberties.end());
+  merged->stones.Set(joint);
+  merged->hash ^= GetZobristKeys().stone[current_player_][joint];
+  chain_ids_[joint] = cid;
+  merged->liberties.Reset(joint);
+  merged->liberties |= liberties;
 }
 
-void GoBoard::UpdateForbiddenPositions() {
-  forbidden_positions_.clear();
-  // A position is forbidden if it is the only liberty of a chain of the
-  // current player and:
+template <int N>
+void GoBoardT<N>::UpdateForbiddenPositions(const CellSet& cells) {
+  // A position is forbidden for a player if it is the only liberty of a
+  // chain of the player and:
   //  * it cannot extend the chain to get more liberties;
   //  * it cannot capture an opponent chain;
-  //  * it cannot connect to a chain of current player to form a live chain.
-  for (const auto& iter : chain_map_) {
-    const GoChain* current_chain = iter.second.get();
-    if (current_chain->color != current_player()) continue;
-    if (current_chain->liberties.size() >= 2) continue;
-    GoPosition only_lib = current_chain->FirstLiberty();  // first and only.
-    bool is_forbidden = true;
-    for (NeighorIterator iter(this, only_lib); !iter.end(); ++iter) {
-      GoPosition p = *iter;
-      if (GetStone(p) == COLOR_NONE) {
-        is_forbidden = false;
-        break;
-      }
-      GoChain* chain = GetChain(p);
-      DCHECK(chain != nullptr);
-      if (chain == current_chain) continue;
-      if (chain->color != current_player() &&
-          chain->liberties.size() == 1) {
-        // Terminate the loop because this is an opponent chain and can
-        // be captured by this move.
-        is_forbidden = false;
-        break;
-      }
-      if (chain->color == current_player() &&
-          chain->liberties.size() >= 2) {
-        // Terminate the loop because this is a friend chain and the
-        // merged chain will have at least one liberty.
-        is_forbidden = false;
-        break;
+  //  * it cannot connect to a chain of the player to form a live chain.
+  // So it only depends on the four neighbors, and needs all of them to be
+  // stones or off the board.
+  forbidden_[0].AndNot(cells);
+  forbidden_[1].AndNot(cells);
+  CellSet enclosed = cells;
+  enclosed &= empty_;
+  enclosed.AndNot(Neighbors(empty_));
+  enclosed.ForEach([this](Index p) {
+    bool in_atari[3] = {false, false, false};  // indexed by color
+    bool not_in_atari[3] = {false, false, false};
+    for (const Index offset : neighbor_offsets()) {
+      const Index cur = p + offset;
+      const GoColor color = StoneAt(cur);
+      if (color == COLOR_OFF_BOARD) continue;
+      if (GetChain(cur)->HasOneLiberty()) {
+        in_atari[color] = true;
+      } else {
+        not_in_atari[color] = true;
       }
     }
-    if (is_forbidden) {
-      forbidden_positions_.insert(only_lib);
+    for (const GoColor player : {COLOR_BLACK, COLOR_WHITE}) {
+      const GoColor opponent = GetOpponent(player);
+      if (in_atari[player] && !not_in_atari[player] && !in_atari[opponent]) {
+        forbidden_[player - 1].Set(p);
+      }
     }
-  }
+  });
 }
 
-void GoBoard::UpdateFeatureSet() {
-  features_->Reset();
-  const bool flip = (current_player() == COLOR_WHITE);
-  int pid = 0;  // orig
-  for (GoSizeT x = 0; x < width(); ++x) {
-    for (GoSizeT y = 0; y < height(); ++y) {
-      const GoColor color = GetStone({x, y});
-      float value = 0.0f;
-      if (color == COLOR_BLACK) {
-        value = flip ? -1.0 : 1.0;
-      } else if (color == COLOR_WHITE) {
-        value = flip ? 1.0 : -1.0;
-      }
-      features_->Set(pid, x, y, value);
-    }
-  }
-
-  for (const auto& iter : chain_map_) {
-    const auto& chain = *iter.second;
-    if (chain.liberties.size() > 3) {
-      continue;
-    }
-    int pid = chain.liberties.size();   // b1, b2 or b3
-    if (chain.color != current_player()) {
-      pid += 3;  // w1, w2 or w3
-    }
-    for (const auto& stone : chain.stones) {
-      features_->Set(pid, stone.first, stone.second, 1);
-    }
+template <int N>
+typename GoBoardT<N>::CellSet GoBoardT<N>::Reach(const CellSet& seeds,
+                                                 const CellSet& area) const {
+  CellSet reached = seeds;
+  while (true) {
+    CellSet grown = Dilate(reached);
+    grown &= area;
+    if (grown == reached) break;
+    reached = grown;
   }
+  return reached;
 }
 
-void GoBoard::EstimateTerritory() {
-  std::fill(approx_territory_.begin(), approx_territory_.end(), 0);
+template <int N>
+void GoBoardT<N>::EstimateTerritory() {
+  ClearTerritory();
   GoSizeT& unknown = approx_territory_[0];
   GoSizeT& black = approx_territory_[1];
   GoSizeT& white = approx_territory_[2];
 
-  for (size_t i = 0; i < stones_.size(); ++i) {
-    if (stones_[i] == COLOR_BLACK) {
-      black += 1;
-    } else if (stones_[i] == COLOR_WHITE) {
-      white += 1;
-    }
-  }
+  CellSet stones[3], only_reach[3];  // indexed by color
+  stones[COLOR_BLACK] = player_stones_[COLOR_BLACK - 1];
+  stones[COLOR_WHITE] = player_stones_[COLOR_WHITE - 1];
+  black = stones[COLOR_BLACK].Count();
+  white = stones[COLOR_WHITE].Count();
   // Heuristic: don't run when the game just begins.
   if (black + white < 11) {
-    unknown = height_ * width_ - black - white;
+    unknown = height() * width() - black - white;
     return;
   }
 
-  // 0: unvisited; [3, max): region id.
-  std::vector<GoSizeT> region_id(width_ * height_, 0);
-  GoSizeT next_region_id = 3;
-  std::vector<GoPosition> stack;
-  for (GoSizeT x = 0; x < width(); ++x) {
-    for (GoSizeT y = 0; y < height(); ++y) {
-      if (GetStone({x, y}) != COLOR_NONE) {
-        // occupied by a stone.
-        continue;
-      }
-      if (region_id[Encode({x, y})] != 0) {
-        // already visited.
-        continue;
-      }
+  GetAreas(stones, only_reach);
+  const int num_black_only = only_reach[COLOR_BLACK].Count();
+  const int num_white_only = only_reach[COLOR_WHITE].Count();
+  black += num_black_only;
+  white += num_white_only;
+  // Regions bordering both players or neither.
+  unknown = empty_.Count() - num_black_only - num_white_only;
+}
 
-      // Start a new region.
-      const GoSizeT current_region_id = next_region_id++;
-      region_id[Encode({x, y})] = current_region_id;
-      int num_black_neighbors = 0;
-      int num_white_neighbors = 0;
-      int num_visited = 0;
-      stack.clear();
-      stack.push_back(std::make_pair(x,y));
-      num_visited++;
-
-      // Floodfill from current coordinate.
-      while (!stack.empty()) {
-        GoPosition cur = stack.back();
-        stack.pop_back();
-        for (NeighorIterator iter(this, cur); !iter.end(); ++iter) {
-          const GoPosition neighbor = *iter;
-          const auto color = GetStone(neighbor);
-          if (color == COLOR_BLACK) {  // Existing black stone.
-            ++num_black_neighbors;
-          } else if (color == COLOR_WHITE) {
-            // Existing white stone.
-            ++num_white_neighbors;
-          } else {
-            DCHECK_EQ(COLOR_NONE, color);
-            if (region_id[Encode(neighbor)] == 0) {  // Unvisited coordinate.
-              stack.push_back(neighbor);
-              region_id[Encode(neighbor)] = current_region_id;
-              num_visited++;
-            }
-          }
+template <int N>
+int GoBoardT<N>::AreaScore(const CellSet* settled) const {
+  CellSet stones[3], only_reach[3];
+  stones[COLOR_BLACK] = player_stones_[COLOR_BLACK - 1];
+  stones[COLOR_WHITE] = player_stones_[COLOR_WHITE - 1];
+  if (settled != nullptr) {
+    // Dead stones in a settled area reach nothing. No other stone reaches
+    // into the area, which is enclosed by its owner's stones.
+    stones[COLOR_BLACK].AndNot(settled[COLOR_WHITE]);
+    stones[COLOR_WHITE].AndNot(settled[COLOR_BLACK]);
+  }
+  GetAreas(stones, only_reach);
+  for (const GoColor player : {COLOR_BLACK, COLOR_WHITE}) {
+    only_reach[player] |= stones[player];
+    if (settled != nullptr) only_reach[player] |= settled[player];
+  }
+  return only_reach[COLOR_BLACK].Count() - only_reach[COLOR_WHITE].Count();
+}
+
+template <int N>
+void GoBoardT<N>::GetPassAlive(CellSet pass_alive[3]) const {
+  CellSet stones[3];
+  stones[COLOR_BLACK] = player_stones_[COLOR_BLACK - 1];
+  stones[COLOR_WHITE] = player_stones_[COLOR_WHITE - 1];
+  CellSet on_board = empty_;
+  on_board |= stones[COLOR_BLACK];
+  on_board |= stones[COLOR_WHITE];
+  pass_alive[COLOR_NONE].Clear();
+
+  for (const GoColor player : {COLOR_BLACK, COLOR_WHITE}) {
+    // The regions of the player are the connected parts of the board left
+    // without its stones. Each one is enclosed by the player's chains.
+    struct Region {
+      CellSet cells;
+      CellSet empties;
+      CellSet border;  // The player's stones next to the region.
+      bool enclosed_by_alive;
+    };
+    std::vector<Region> regions;
+    CellSet rest = on_board;
+    rest.AndNot(stones[player]);
+    while (!rest.Empty()) {
+      CellSet seed;
+      seed.Set(rest.First());
+      Region region;
+      region.cells = Reach(seed, rest);
+      region.empties = region.cells;
+      region.empties &= empty_;
+      region.border = Neighbors(region.cells);
+      region.border &= stones[player];
+      region.enclosed_by_alive = true;
+      rest.AndNot(region.cells);
+      regions.push_back(region);
+    }
+    std::vector<const Chain*> chains;
+    ForEachChain([player, &chains](const Chain& chain) {
+      if (chain.color == player) chains.push_back(&chain);
+    });
+
+    // A region is vital to a chain if all its empty cells are liberties of
+    // the chain. Chains with less than two vital regions enclosed by alive
+    // chains are not alive, and neither are regions next to them; repeat
+    // until nothing changes.
+    CellSet alive = stones[player];
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (const Chain*& chain : chains) {
+        if (chain == nullptr) continue;
+        int num_vital = 0;
+        for (const Region& region : regions) {
+          if (!region.enclosed_by_alive || region.empties.Empty()) continue;
+          CellSet outside = region.empties;
+          outside.AndNot(chain->liberties);
+          if (outside.Empty() && ++num_vital == 2) break;
+        }
+        if (num_vital < 2) {
+          alive.AndNot(chain->stones);
+          chain = nullptr;
+          changed = true;
         }
       }
-
-      if ((num_black_neighbors != 0 && num_white_neighbors != 0) ||
-          (num_black_neighbors == 0 && num_white_neighbors == 0)) {
-        unknown += num_visited;
-      } else if (num_black_neighbors != 0 && num_white_neighbors == 0) {
-        black += num_visited;
-      } else if (num_black_neighbors == 0 && num_white_neighbors != 0) {
-        white += num_visited;
+      for (Region& region : regions) {
+        if (!region.enclosed_by_alive) continue;
+        CellSet not_alive = region.border;
+        not_alive.AndNot(alive);
+        if (!not_alive.Empty()) {
+          region.enclosed_by_alive = false;
+          changed = true;
+        }
       }
-    }  // for y
-  }  // for x
+    }
+
+    pass_alive[player] = alive;
+    const CellSet next_to_alive = Neighbors(alive);
+    for (const Region& region : regions) {
+      if (!region.enclosed_by_alive) continue;
+      CellSet far = region.empties;
+      far.AndNot(next_to_alive);
+      if (far.Empty()) pass_alive[player] |= region.cells;
+    }
+  }
+}
+
+template <int N>
+void GoBoardT<N>::GetAreas(const CellSet stones[3],
+                           CellSet only_reach[3]) const {
+  // An empty region belongs to a player if it only borders the player's
+  // stones. The regions bordering black stones are the empty cells reached
+  // from them, grown one step in all directions at a time; same for white.
+  CellSet black_reach = Neighbors(stones[COLOR_BLACK]);
+  black_reach &= empty_;
+  CellSet white_reach = Neighbors(stones[COLOR_WHITE]);
+  white_reach &= empty_;
+  // Only regions of more than one cell need growing. Late in a game, and at
+  // the end of every playout, most regions are single eyes.
+  CellSet joined = Neighbors(empty_);
+  joined &= empty_;
+  if (!joined.Empty()) {
+    CellSet seeds = black_reach;
+    seeds &= joined;
+    black_reach |= Reach(seeds, joined);
+    seeds = white_reach;
+    seeds &= joined;
+    white_reach |= Reach(seeds, joined);
+  }
+  only_reach[COLOR_BLACK] = black_reach;
+  only_reach[COLOR_BLACK].AndNot(white_reach);
+  only_reach[COLOR_WHITE] = white_reach;
+  only_reach[COLOR_WHITE].AndNot(black_reach);
 }
 
-std::string GoBoard::DebugString(bool output_chains) const {
+template <int N>
+std::string GoBoardT<N>::DebugString(bool output_chains) const {
   std::string ascii;
 
   // Print basic information:
   StrAppend(&ascii, "Current player: ", current_player());
 
-  if (ko_ != kNPos) {
-    StrAppend(&ascii, ", Ko: ", ToString(ko_), "\n");
+  if (ko_ != kNoCell) {
+    StrAppend(&ascii, ", Ko: ", ToString(FromIndex(ko_)), "\n");
   } else {
     StrAppend(&ascii, "\n");
   }
@@ -524,7 +947,7 @@ std::string GoBoard::DebugString(bool output_chains) const {
   for (GoSizeT j = height() - 1; j >= 0; --j) {
     StrAppend(&ascii, absl::Dec(j+1, absl::kZeroPad2), "|");
     for (GoSizeT i = 0; i < width(); ++i) {
-      StrAppend(&ascii, kSyms[GetStone({i, j})]);
+      StrAppend(&ascii, kSyms[StoneAt(ToIndex({i, j}))]);
     }
     StrAppend(&ascii, "|", absl::Dec(j+1, absl::kZeroPad2), "\n");
   }
@@ -533,31 +956,488 @@ std::string GoBoard::DebugString(bool output_chains) const {
 
   // Print chains if requested.
   if (output_chains) {
-    for (const auto& iter : chain_map_) {
-      StrAppend(&ascii, iter.second->DebugString());
-    }
+    ForEachChain([this, &ascii](const Chain& chain) {
+      StrAppend(&ascii, chain.DebugString(*this));
+    });
   }
 
   // Print forbidden positions:
-  if (!forbidden_positions_.empty()) {
-    StrAppend(&ascii, "Forbidden: ", ToString(forbidden_positions_), "\n");
+  if (!forbidden().Empty()) {
+    std::vector<GoPosition> forbidden;
+    this->forbidden().ForEach([this, &forbidden](Index idx) {
+      forbidden.push_back(FromIndex(idx));
+    });
+    StrAppend(&ascii, "Forbidden: ", ToString(forbidden), "\n");
   }
   return ascii;
 }
 
-std::unique_ptr<GoBoard::GoChain> GoBoard::GoChain::Clone() const {
-  auto copy = absl::make_unique<GoBoard::GoChain>(color, chain_id);
-  copy->stones = stones;
-  copy->liberties = liberties;
-  return copy;
-}
-
-std::string GoBoard::GoChain::DebugString() const {
+template <int N>
+std::string GoBoardT<N>::Chain::DebugString(const GoBoardT& board) const {
   std::string ascii;
   StrAppend(&ascii, (color == COLOR_BLACK ? "Black" : "White"),
-            " Chain #", chain_id, ", #lib=", liberties.size(), ", ");
-  StrAppend(&ascii, "Stones: ", ToString(stones ), "\n");
+            " Chain #", this - board.chains_, ", #lib=", liberties.Count(),
+            ", ");
+  std::vector<GoPosition> positions;
+  stones.ForEach([&board, &positions](Index stone) {
+    positions.push_back(board.FromIndex(stone));
+  });
+  StrAppend(&ascii, "Stones: ", ToString(positions), "\n");
   return ascii;
 }
 
+template class GoBoardT<0>;
+template class GoBoardT<9>;
+template class GoBoardT<13>;
+template class GoBoardT<19>;
+
+namespace {
+
+// GoBoardCore on top of a GoBoardT<N>, which also keeps the undo journal.
+template <int N>
+class GoBoardCoreImpl : public GoBoardCore {
+ public:
+  typedef GoBoardT<N> Board;
+  typedef typename Board::Index Index;
+
+  GoBoardCoreImpl(GoSizeT width, GoSizeT height)
+      : board_(absl::make_unique<Board>(width, height)) {}
+
+  explicit GoBoardCoreImpl(std::unique_ptr<Board> board)
+      : board_(std::move(board)) {}
+
+  std::unique_ptr<GoBoardCore> Clone() const override {
+    auto copy = absl::make_unique<GoBoardCoreImpl>(board_->Clone());
+    copy->undo_journal_ = undo_journal_;
+    copy->history_ = history_;
+    copy->history_next_ = history_next_;
+    copy->history_size_ = history_size_;
+    return std::move(copy);
+  }
+
+  GoColor current_player() const override { return board_->current_player(); }
+  uint64_t hash() const override { return board_->hash(); }
+
+  GoColor GetStone(GoPosition pos) const override {
+    return board_->StoneAt(board_->ToIndex(pos));
+  }
+
+  bool IsLegalMove(GoPosition pos) const override {
+    return board_->IsLegalMove(board_->ToIndex(pos));
+  }
+
+  uint64_t StonesHash() const override { return board_->StonesHash(); }
+
+  uint64_t StonesHashAfterMove(GoPosition pos) const override {
+    return board_->StonesHashAfterMove(board_->ToIndex(pos));
+  }
+
+  void GetLegalMoves(std::vector<uint8_t>* mask) const override {
+    const typename Board::CellSet legal = board_->LegalMoves();
+    const GoSizeT width = board_->width();
+    mask->resize(width * board_->height());
+    uint8_t* out = mask->data();
+    for (GoSizeT y = 0; y < board_->height(); ++y) {
+      const Index row = board_->ToIndex({0, y});
+      for (GoSizeT x = 0; x < width; ++x) {
+        *out++ = legal.Test(row + x);
+      }
+    }
+  }
+
+  void Play(GoPosition pos, std::vector<GoPosition>* captured_stones,
+            bool record_undo) override {
+    PushHistory();
+    typename Board::CellSet deads;
+    board_->Play(board_->ToIndex(pos), &deads, NextUndoRecord(record_undo));
+    if (captured_stones != nullptr) {
+      captured_stones->clear();
+      deads.ForEach([this, captured_stones](Index dead) {
+        captured_stones->push_back(board_->FromIndex(dead));
+      });
+    }
+  }
+
+  void Pass(bool record_undo) override {
+    PushHistory();
+    board_->Pass(NextUndoRecord(record_undo));
+  }
+
+  void Undo() override {
+    CHECK(!undo_journal_.empty());
+    board_->Undo(undo_journal_.back());
+    undo_journal_.pop_back();
+    // The newest position of the ring is the current one again.
+    if (history_size_ > 0) {
+      history_next_ = (history_next_ + history_.size() - 1) % history_.size();
+      --history_size_;
+    }
+  }
+
+  void GetPassAlive(std::vector<GoColor>* owners) const override {
+    typename Board::CellSet pass_alive[3];
+    board_->GetPassAlive(pass_alive);
+    owners->resize(board_->width() * board_->height());
+    GoColor* out = owners->data();
+    for (GoSizeT y = 0; y < board_->height(); ++y) {
+      const Index row = board_->ToIndex({0, y});
+      for (GoSizeT x = 0; x < board_->width(); ++x) {
+        *out++ = pass_alive[COLOR_BLACK].Test(row + x)   ? COLOR_BLACK
+                 : pass_alive[COLOR_WHITE].Test(row + x) ? COLOR_WHITE
+                                                         : COLOR_NONE;
+      }
+    }
+  }
+
+  int AreaScore(bool count_settled) const override {
+    if (!count_settled) return board_->AreaScore();
+    typename Board::CellSet settled[3];
+    board_->GetPassAlive(settled);
+    return board_->AreaScore(settled);
+  }
+
+  void EstimateTerritory() override { board_->EstimateTerritory(); }
+  void ClearTerritory() override { board_->ClearTerritory(); }
+  GoSizeT approx_territory(int i) const override {
+    return board_->approx_territory(i);
+  }
+
+  void RebuildFeatures(GoFeatureSet* features) override {
+    features->Reset();
+    for (GoSizeT y = 0; y < board_->height(); ++y) {
+      const Index row = board_->ToIndex({0, y});
+      for (Index idx = row; idx < row + board_->width(); ++idx) {
+        UpdateCellFeatures(idx, features);
+      }
+    }
+    board_->set_track_dirty(true);
+  }
+
+  void UpdateDirtyFeatures(GoFeatureSet* features) override {
+    board_->dirty().ForEach(
+        [this, features](Index idx) { UpdateCellFeatures(idx, features); });
+    board_->ClearDirty();
+  }
+
+  void StopTrackingDirty() override { board_->set_track_dirty(false); }
+
+  void SetHistoryLength(int length) override {
+    history_.assign(length, Layout());
+    history_next_ = 0;
+    history_size_ = 0;
+  }
+
+  void WriteHistoryFeatures(GoFeatureSet* features) const override {
+    uint8_t* cells = features->mutable_history_cells();
+    std::fill(cells, cells + board_->width() * board_->height(), 0);
+    const int length = history_.size();
+    const int own = board_->current_player() - 1;
+    for (int k = 0; k < history_size_; ++k) {
+      const Layout& layout =
+          history_[(history_next_ - 1 - k + length) % length];
+      for (const int player : {0, 1}) {
+        const uint8_t bit = 1 << (2 * k + (player == own ? 0 : 1));
+        layout.stones[player].ForEach([this, cells, bit](Index idx) {
+          const GoPosition pos = board_->FromIndex(idx);
+          cells[pos.second * board_->width() + pos.first] |= bit;
+        });
+      }
+    }
+  }
+
+  void ReadTactics(int max_nodes, uint8_t* moves) override {
+    typename Board::CellSet captures, escapes;
+    reader_.Read(*board_, max_nodes, &captures, &escapes);
+    for (GoSizeT y = 0; y < board_->height(); ++y) {
+      const Index row = board_->ToIndex({0, y});
+      for (GoSizeT x = 0; x < board_->width(); ++x) {
+        *moves++ = (captures.Test(row + x) ? kTacticalCapture : 0) |
+                   (escapes.Test(row + x) ? kTacticalEscape : 0);
+      }
+    }
+  }
+
+  TacticalStatus ReadChain(GoPosition pos, int max_nodes) override {
+    return reader_.ReadChain(*board_, board_->ToIndex(pos), max_nodes);
+  }
+
+  std::string DebugString(bool output_chains) const override {
+    return board_->DebugString(output_chains);
+  }
+
+  void Accept(GoBoardCoreVisitor* visitor) const override {
+    visitor->Visit(*board_);
+  }
+
+ private:
+  typename Board::UndoRecord* NextUndoRecord(bool record_undo) {
+    if (!record_undo) {
+      return nullptr;
+    }
+    undo_journal_.emplace_back();
+    return &undo_journal_.back();
+  }
+
+  // Saves the current position into the history ring, if there is one.
+  void PushHistory() {
+    if (history_.empty()) return;
+    Layout& layout = history_[history_next_];
+    layout.stones[0] = board_->stones(COLOR_BLACK);
+    layout.stones[1] = board_->stones(COLOR_WHITE);
+    history_next_ = (history_next_ + 1) % history_.size();
+    history_size_ = std::min<int>(history_size_ + 1, history_.size());
+  }
+
+  // Rewrites the features of one cell for current player.
+  void UpdateCellFeatures(Index idx, GoFeatureSet* features) const {
+    const GoPosition pos = board_->FromIndex(idx);
+    const GoColor color = board_->StoneAt(idx);
+    if (color == COLOR_NONE) {
+      features->SetCell(pos.first, pos.second, 0);
+      return;
+    }
+    const bool own = (color == board_->current_player());
+    uint8_t cell = own ? 1 : GoFeatureSet::kNegativeOrig;  // orig
+    const int num_liberties = board_->GetChain(idx)->liberties.Count();
+    if (num_liberties >= 1 && num_liberties <= 3) {
+      // b1, b2 or b3 for current player, w1, w2 or w3 for the opponent.
+      cell |= 1 << (own ? num_liberties : num_liberties + 3);
+    }
+    features->SetCell(pos.first, pos.second, cell);
+  }
+
+  std::unique_ptr<Board> board_;
+  std::vector<typename Board::UndoRecord> undo_journal_;
+
+  // Stones of black and white in a position, indexed by color - 1.
+  struct Layout {
+    typename Board::CellSet stones[2];
+  };
+  // The history ring, see SetHistoryLength. The newest position is right
+  // before "history_next_"; "history_size_" positions are valid.
+  std::vector<Layout> history_;
+  int history_next_ = 0;
+  int history_size_ = 0;
+
+  // Scratch space of ReadTactics and ReadChain, not copied by Clone.
+  TacticalReaderT<N> reader_;
+};
+
+std::unique_ptr<GoBoardCore> NewGoBoardCore(GoSizeT width, GoSizeT height) {
+  if (width == height) {
+    switch (width) {
+      case 9:
+        return absl::make_unique<GoBoardCoreImpl<9>>(width, height);
+      case 13:
+        return absl::make_unique<GoBoardCoreImpl<13>>(width, height);
+      case 19:
+        return absl::make_unique<GoBoardCoreImpl<19>>(width, height);
+    }
+  }
+  return absl::make_unique<GoBoardCoreImpl<0>>(width, height);
+}
+
+}  // namespace
+
+GoBoard::GoBoard(GoSizeT width, GoSizeT height)
+    : GoBoard(width, height, NewGoBoardCore(width, height)) {}
+
+GoBoard::GoBoard(GoSizeT width, GoSizeT height,
+                 std::unique_ptr<GoBoardCore> core)
+    : width_(width), height_(height), core_(std::move(core)) {}
+
+GoBoard::~GoBoard() {}
+
+std::unique_ptr<GoBoard> GoBoard::Clone() const {
+  std::unique_ptr<GoBoard> c(new GoBoard(width_, height_, core_->Clone()));
+  c->positional_superko_ = positional_superko_;
+  c->position_history_ = position_history_;
+  c->undo_enabled_ = undo_enabled_;
+  c->added_to_history_ = added_to_history_;
+  c->features_enabled_ = features_enabled_;
+  c->tactics_max_nodes_ = tactics_max_nodes_;
+  c->tactics_hash_ = tactics_hash_;
+  c->history_length_ = history_length_;
+  c->history_stale_ = history_stale_;
+  if (features_ != nullptr) {
+    c->features_ = features_->Clone();
+    c->features_player_ = features_player_;
+  }
+  return c;
+}
+
+bool GoBoard::IsLegalMove(GoPosition move) const {
+  if (move == kMovePass || move == kMoveResign) {
+    return true;
+  }
+  if (!IsValidPosition(move)) {  // Out of the board's boundary.
+    return false;
+  }
+  if (!core_->IsLegalMove(move)) {  // Occupied, ko or suicide.
+    return false;
+  }
+  if (positional_superko_ &&
+      position_history_.count(core_->StonesHashAfterMove(move)) > 0) {
+    return false;
+  }
+  return true;
+}
+
+const std::vector<uint8_t>& GoBoard::GetLegalMoves() const {
+  if (!legal_moves_valid_) {
+    core_->GetLegalMoves(&legal_moves_);
+    if (positional_superko_) {
+      for (size_t i = 0; i < legal_moves_.size(); ++i) {
+        if (legal_moves_[i] &&
+            position_history_.count(core_->StonesHashAfterMove(Decode(i)))) {
+          legal_moves_[i] = 0;
+        }
+      }
+    }
+    legal_moves_valid_ = true;
+  }
+  return legal_moves_;
+}
+
+void GoBoard::EnablePositionalSuperko() {
+  legal_moves_valid_ = false;
+  positional_superko_ = true;
+  position_history_.insert(core_->StonesHash());
+}
+
+// Dead stones of the opponent will be put to "dead".
+bool GoBoard::Move(GoPosition move, bool estimate_territory,
+                   std::vector<GoPosition>* captured_stones) {
+  if (!IsLegalMove(move)) {
+    return false;
+  }
+  if (move == kMoveResign) {
+    return true;
+  }
+  legal_moves_valid_ = false;
+  history_stale_ = true;
+
+  if (move == kMovePass) {
+    core_->Pass(undo_enabled_);
+    if (undo_enabled_) {
+      added_to_history_.push_back(false);
+    }
+    if (estimate_territory) {
+      core_->EstimateTerritory();
+    }
+    return true;
+  }
+
+  core_->Play(move, captured_stones, undo_enabled_);
+  bool added = false;
+  if (positional_superko_) {
+    added = position_history_.insert(core_->StonesHash()).second;
+  }
+  if (undo_enabled_) {
+    added_to_history_.push_back(added);
+  }
+
+  if (estimate_territory) {
+    core_->EstimateTerritory();
+  } else {
+    core_->ClearTerritory();
+  }
+  return true;
+}
+
+bool GoBoard::Undo() {
+  if (added_to_history_.empty()) {
+    return false;
+  }
+  if (added_to_history_.back()) {
+    position_history_.erase(core_->StonesHash());
+  }
+  core_->Undo();
+  added_to_history_.pop_back();
+  legal_moves_valid_ = false;
+  history_stale_ = true;
+  return true;
+}
+
+void GoBoard::ReadTactics(int max_nodes, std::vector<uint8_t>* moves) const {
+  moves->resize(width_ * height_);
+  core_->ReadTactics(max_nodes, moves->data());
+}
+
+TacticalStatus GoBoard::ReadChain(GoPosition pos, int max_nodes) const {
+  CHECK(IsValidPosition(pos)) << ToString(pos);
+  return core_->ReadChain(pos, max_nodes);
+}
+
+void GoBoard::EnableTacticalFeatures(int max_nodes) {
+  CHECK_GT(max_nodes, 0);
+  CHECK(features_enabled_) << "Feature planes are disabled on this board.";
+  tactics_max_nodes_ = max_nodes;
+  // The next GetFeatures builds a feature set with the new planes.
+  features_.reset();
+}
+
+void GoBoard::EnableHistoryFeatures(int num_positions) {
+  CHECK(num_positions > 0 && num_positions <= GoFeatureSet::kMaxHistory)
+      << num_positions;
+  CHECK(features_enabled_) << "Feature planes are disabled on this board.";
+  history_length_ = num_positions;
+  core_->SetHistoryLength(num_positions);
+  features_.reset();
+}
+
+const GoFeatureSet& GoBoard::GetFeatures() const {
+  CHECK(features_enabled_) << "Feature planes are disabled on this board.";
+  if (features_ == nullptr) {
+    features_ = absl::make_unique<GoFeatureSet>(
+        width(), height(), tactical_features(), history_length_);
+    features_player_ = current_player();
+    // From now on, the core tells which cells to rewrite.
+    core_->RebuildFeatures(features_.get());
+    if (tactical_features()) {
+      core_->ReadTactics(tactics_max_nodes_,
+                         features_->mutable_tactical_cells());
+      tactics_hash_ = hash();
+    }
+    if (history_length_ > 0) {
+      core_->WriteHistoryFeatures(features_.get());
+      history_stale_ = false;
+    }
+  } else {
+    UpdateFeatureSet();
+  }
+  return *features_;
+}
+
+void GoBoard::DisableFeatures() {
+  features_enabled_ = false;
+  features_.reset();
+  core_->StopTrackingDirty();
+  if (history_length_ > 0) {
+    history_length_ = 0;
+    core_->SetHistoryLength(0);
+  }
+}
+
+void GoBoard::UpdateFeatureSet() const {
+  if (features_player_ != current_player()) {
+    features_player_ = current_player();
+    features_->Negate(0);  // orig
+    for (int pid = 1; pid <= 3; ++pid) {
+      features_->SwapPlanes(pid, pid + 3);  // b* and w*
+    }
+  }
+  core_->UpdateDirtyFeatures(features_.get());
+  // Ladders are not local, so the tactical planes are read again in full.
+  if (tactical_features() && tactics_hash_ != hash()) {
+    core_->ReadTactics(tactics_max_nodes_, features_->mutable_tactical_cells());
+    tactics_hash_ = hash();
+  }
+  // Every position moves one step back in the history.
+  if (history_length_ > 0 && history_stale_) {
+    core_->WriteHistoryFeatures(features_.get());
+    history_stale_ = false;
+  }
+}
+
 }  // namespace zebra_go
@@ -1,12 +1,13 @@
 #ifndef ZEBRA_GO_ENGINE_GO_GAME_H_
 #define ZEBRA_GO_ENGINE_GO_GAME_H_
 
+#include <array>
 #include <cstdint>
+#include <cstring>
 #include <memory>
-#include <set>
 #include <string>
 #include <tuple>
-#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -14,6 +15,7 @@
 
 #include "absl/strings/str_join.h"
 #include "absl/strings/string_view.h"
+#include "engine/bit_board.h"
 
 namespace zebra_go {
 
@@ -22,6 +24,9 @@ enum GoColor {
   COLOR_NONE  = 0,
   COLOR_BLACK = 1,
   COLOR_WHITE = 2,
+  // Sentinel for the border cells around the board. GoBoard never returns it
+  // for a valid position.
+  COLOR_OFF_BOARD = 3,
 };
 
 // Integer type for the coordinate system.
@@ -31,6 +36,8 @@ typedef int16_t GoSizeT;
 typedef std::pair<GoSizeT, GoSizeT> GoPosition;
 
 constexpr GoSizeT kMaxBoardSize = 25;
+// Number of cells of the largest board in GoBoard's padded layout.
+constexpr int kMaxNumCells = (kMaxBoardSize + 2) * (kMaxBoardSize + 2);
 constexpr GoPosition kNPos = {-1, -1};        // Not a valid position.
 constexpr GoPosition kMovePass = {-2, -2};    // A player passes.
 constexpr GoPosition kMoveResign = {-3, -3};  // A player resigns.
@@ -56,13 +63,501 @@ std::string ToString(const ContainerT& stones) {
 // Gets the color of the opponent of player "s".
 GoColor GetOpponent(GoColor s);
 
+// Result of reading a chain for ladders and captures, see
+// GoBoard::ReadChain.
+enum TacticalStatus {
+  TACTICS_UNKNOWN  = 0,  // The node budget ran out.
+  TACTICS_SAFE     = 1,
+  TACTICS_CAPTURED = 2,
+};
+
+// Flags of a move in GoBoard::ReadTactics.
+constexpr uint8_t kTacticalCapture = 1 << 0;
+constexpr uint8_t kTacticalEscape  = 1 << 1;
+
 class GoFeatureSet;
 
+// The rules engine behind GoBoard: stones, chains and their liberties, ko,
+// suicide positions and the position key. It only holds plain data in
+// fixed-capacity arrays, without pointers or heap storage, so copying a board
+// is a single memcpy.
+//
+// N is the size of a square board known at compile time. Then the geometry
+// (row length, neighbor offsets, loop bounds) is made of constants and the
+// arrays and cell sets are sized for that board. N = 0 is the general case,
+// where the size is given at runtime and the storage fits the largest board.
+// Only N = 0, 9, 13 and 19 are instantiated, see go_game.cc.
+template <int N>
+class GoBoardT {
+ public:
+  static_assert(N >= 0 && N <= kMaxBoardSize, "Unsupported board size.");
+
+  // Number of cells in the padded layout, see Index.
+  static constexpr int kNumCells = N > 0 ? (N + 2) * (N + 2) : kMaxNumCells;
+
+  // Maximum number of chains that can be on the board at the same time.
+  static constexpr int kMaxNumChains =
+      N > 0 ? N * N : kMaxBoardSize * kMaxBoardSize;
+
+  // Index of a cell in the padded layout. The board is stored row by row in a
+  // (width + 2) * (height + 2) array, where the extra rows and columns are
+  // filled with COLOR_OFF_BOARD. So the four neighbors of any on-board cell
+  // are always at fixed offsets and no boundary check is needed. Cell 0 is
+  // always off the board, so it doubles as "no cell".
+  typedef int16_t Index;
+  static constexpr Index kNoCell = 0;
+
+  // A set of cells.
+  typedef BitBoard<(kNumCells + 63) / 64> CellSet;
+
+  struct Chain {
+    // Gets the first liberty.
+    Index FirstLiberty() const {
+      DCHECK(!liberties.Empty());
+      return liberties.First();
+    }
+
+    // Returns true if the chain is in atari.
+    bool HasOneLiberty() const { return liberties.IsSingleton(); }
+
+    // Returns a readable string for debugging.
+    std::string DebugString(const GoBoardT& board) const;
+
+    // COLOR_NONE if this slot of the chain pool is free.
+    GoColor color;
+    CellSet stones;
+    CellSet liberties;
+    // XOR of the Zobrist keys of all stones, so removing the chain from the
+    // position key is a single XOR.
+    uint64_t hash;
+  };
+
+  // What Play or Pass changed, so that Undo can restore the previous state.
+  struct UndoRecord {
+    Index move;  // kNoCell for a pass.
+    // State before the move.
+    Index ko;
+    uint64_t hash;
+    GoSizeT approx_territory[3];
+    CellSet forbidden[2];
+    int16_t num_chain_slots;
+    int16_t num_free_chain_ids;
+    // The chain created for the stone, or kNoChain if the stone was merged
+    // into existing chains of current player.
+    int16_t new_chain_id;
+    // Chains of current player merged by the stone, as they were before.
+    int16_t merged_ids[4];
+    Chain merged_chains[4];
+    int num_merged;
+    // Opponent chains captured by the stone.
+    int16_t captured_ids[4];
+    Chain captured_chains[4];
+    int num_captured;
+    // Opponent chains that lost the cell of the move as a liberty.
+    int16_t opponent_ids[4];
+    int num_opponents;
+  };
+
+  // If N is not 0, the size must be N * N.
+  GoBoardT(GoSizeT width, GoSizeT height);
+
+  // Returns a copy made with one memcpy, which only covers the used part of
+  // the chain pool.
+  std::unique_ptr<GoBoardT> Clone() const;
+
+  // Overwrites this board with "other", the same way as Clone but without
+  // allocating.
+  void CopyFrom(const GoBoardT& other) {
+    std::memcpy(this, &other, other.UsedBytes());
+  }
+
+  GoSizeT width() const  { return N > 0 ? N : width_;  }
+  GoSizeT height() const { return N > 0 ? N : height_; }
+  GoColor current_player() const { return current_player_; }
+
+  // See GoBoard::hash().
+  uint64_t hash() const { return hash_; }
+
+  // The cell current player can't play on because of ko, or kNoCell.
+  Index ko() const { return ko_; }
+
+  // Boundary check.
+  bool IsValidPosition(GoPosition move) const {
+    return (move.first >= 0 && move.first < width() &&
+            move.second >= 0 && move.second < height());
+  }
+
+  // Converts between a position and its index in the padded layout.
+  // Row length of the padded layout, i.e. width + 2.
+  Index stride() const { return N > 0 ? N + 2 : stride_; }
+
+  // Offsets from a cell to its four neighbors in the padded layout.
+  std::array<Index, 4> neighbor_offsets() const {
+    return {{static_cast<Index>(-stride()), stride(), -1, 1}};
+  }
+
+  Index ToIndex(GoPosition pos) const {
+    DCHECK(IsValidPosition(pos));
+    return (pos.second + 1) * stride() + pos.first + 1;
+  }
+  GoPosition FromIndex(Index idx) const {
+    return GoPosition(idx % stride() - 1, idx / stride() - 1);
+  }
+
+  GoColor StoneAt(Index idx) const {
+    return static_cast<GoColor>(stones_[idx]);
+  }
+
+  // Gets the chain that occupies the cell. Returns nullptr if there is no
+  // stone on the cell.
+  const Chain* GetChain(Index idx) const {
+    const int16_t chain_id = chain_ids_[idx];
+    return chain_id == kNoChain ? nullptr : &chains_[chain_id];
+  }
+
+  // Runs f(const Chain&) for every chain on the board.
+  template <typename F>
+  void ForEachChain(F f) const {
+    for (int16_t id = 1; id <= num_chain_slots_; ++id) {
+      if (chains_[id].color != COLOR_NONE) f(chains_[id]);
+    }
+  }
+
+  // Stones of "player", which is COLOR_BLACK or COLOR_WHITE.
+  const CellSet& stones(GoColor player) const {
+    return player_stones_[player - 1];
+  }
+
+  // Suicide positions of current player.
+  const CellSet& forbidden() const { return forbidden_[current_player_ - 1]; }
+
+  // Cells whose stone, or the liberty count of whose chain, may have changed
+  // since the last ClearDirty(). Only tracked when turned on by
+  // set_track_dirty, which is off for a new board.
+  const CellSet& dirty() const { return dirty_; }
+  void ClearDirty() { dirty_.Clear(); }
+  void set_track_dirty(bool track) {
+    track_dirty_ = track;
+    dirty_.Clear();
+  }
+
+  // 3x3 neighborhoods for playouts. They are only kept up to date when turned
+  // on by set_track_patterns, which is off for a new board; turning it on
+  // computes them for the whole board.
+  //
+  // pattern(idx) holds the colors of the 8 cells around "idx", 2 bits each,
+  // in the order of pattern_offsets(): the color of cell i is in bits 2i and
+  // 2i+1. Off-board cells are COLOR_OFF_BOARD.
+  uint16_t pattern(Index idx) const { return patterns_[idx]; }
+  // For an empty cell, bit i is set if the chain on neighbor i, in the order
+  // of neighbor_offsets(), is in atari. 0 for a stone.
+  uint8_t atari_flags(Index idx) const { return atari_flags_[idx]; }
+  void set_track_patterns(bool track);
+
+  // Offsets from a cell to the 8 cells around it, row by row. Opposite cells
+  // are at i and 7 - i.
+  std::array<Index, 8> pattern_offsets() const {
+    const Index s = stride();
+    return {{static_cast<Index>(-s - 1), static_cast<Index>(-s),
+             static_cast<Index>(-s + 1), -1, 1, static_cast<Index>(s - 1), s,
+             static_cast<Index>(s + 1)}};
+  }
+
+  // Checks if current player can play on the cell, except for superko.
+  bool IsLegalMove(Index idx) const {
+    return StoneAt(idx) == COLOR_NONE && idx != ko_ && !forbidden().Test(idx);
+  }
+
+  // Cells where IsLegalMove is true: the empty cells, minus the ko and the
+  // forbidden positions.
+  CellSet LegalMoves() const {
+    CellSet legal = empty_;
+    legal.AndNot(forbidden());
+    if (ko_ != kNoCell) legal.Reset(ko_);
+    return legal;
+  }
+
+  // Current player places a stone on the cell, which must be a legal move.
+  // Captured stones are put in "captured". If "undo" is not null, it records
+  // how to take the move back.
+  void Play(Index idx, CellSet* captured, UndoRecord* undo);
+
+  // Current player passes. "undo" is nullable, like in Play.
+  void Pass(UndoRecord* undo);
+
+  // Takes back the last move, which must be the one "undo" was recorded for.
+  void Undo(const UndoRecord& undo);
+
+  // Zobrist key of the stones only, i.e. hash() without the player to move
+  // and the ko point. This is what positional superko compares.
+  uint64_t StonesHash() const;
+
+  // StonesHash() after current player places a stone on the empty cell,
+  // taking captures into account.
+  uint64_t StonesHashAfterMove(Index idx) const;
+
+  // Area score by Tromp-Taylor rules, without komi: black's stones and the
+  // empty cells that only reach black stones, minus the same for white.
+  // "settled" is nullable; if given, it is indexed by color as in
+  // GetPassAlive, and its cells count for their owner whatever is on them.
+  int AreaScore(const CellSet* settled = nullptr) const;
+
+  // Benson's unconditional life. Gets, indexed by color, the chains of each
+  // player that can't be captured even if the player always passes, together
+  // with the regions they enclose where every empty cell is next to one of
+  // them, so the opponent can't make an eye there. The opponent stones in
+  // those regions are dead. Nothing either player does changes who owns a
+  // settled cell, so search and playouts can skip moves there.
+  void GetPassAlive(CellSet pass_alive[3]) const;
+
+  // Estimates terriotory for each player. Results can be accessed through
+  // approx_territory.
+  void EstimateTerritory();
+  void ClearTerritory() { approx_territory_[0] = approx_territory_[1] =
+                              approx_territory_[2] = 0; }
+  // 0: shared; 1: black; 2: white.
+  GoSizeT approx_territory(int i) const { return approx_territory_[i]; }
+
+  // Prints a readable string for debugging.
+  std::string DebugString(bool output_chains) const;
+
+ private:
+  static constexpr int16_t kNoChain = 0;
+
+  // Distinct chains adjacent to a cell. There are at most four of them.
+  struct AdjacentChains {
+    void Add(Chain* chain) {
+      for (int i = 0; i < size; ++i) {
+        if (chains[i] == chain) return;
+      }
+      chains[size++] = chain;
+    }
+    Chain* const* begin() const { return chains; }
+    Chain* const* end() const { return chains + size; }
+    bool empty() const { return size == 0; }
+
+    Chain* chains[4];
+    int size = 0;
+  };
+
+  Chain* MutableChain(Index idx) {
+    const int16_t chain_id = chain_ids_[idx];
+    return chain_id == kNoChain ? nullptr : &chains_[chain_id];
+  }
+
+  // Gets the chains and liberties (unoccupied cells) that are adjacent
+  // to the cell. Chains of current player will be returned in "neighbors"
+  // and chains of the opponent will be returned in "opponents". "liberties" is
+  // nullable, if caller doesn't care about liberties.
+  void GetAdjacentChains(Index idx, AdjacentChains* neighbors,
+                         AdjacentChains* opponents, CellSet* liberties) const;
+
+  // Removes the chain from the board and adds its stones to "deads".
+  void RemoveChain(Chain* c, CellSet* deads);
+
+  // Creates a new chain with the stone which has the given liberties.
+  Chain* CreateNewChain(Index stone, const CellSet& liberties);
+
+  // Merges the chains into one chain, where these chains must be able to be
+  // joined together by the stone. "liberties" are the joint stone's liberties.
+  void MergeChains(Index joint, const CellSet& liberties,
+                   const AdjacentChains& chains);
+
+  // Recomputes, for both players, whether each empty cell of "cells" is a
+  // forbidden position. A cell only needs it when a chain next to it changed
+  // its stones or its liberties.
+  void UpdateForbiddenPositions(const CellSet& cells);
+
+  void MarkDirty(const CellSet& cells) {
+    if (track_dirty_) dirty_ |= cells;
+  }
+
+  // Writes "color" into the pattern of the 8 cells around "idx".
+  void SetPatternColor(Index idx, GoColor color);
+
+  // Recomputes atari_flags(idx).
+  void UpdateAtariFlags(Index idx);
+
+  // Recomputes all patterns and atari flags.
+  void RebuildPatterns();
+
+  // Returns the cells together with their four neighbors.
+  CellSet Dilate(const CellSet& cells) const {
+    CellSet result = Neighbors(cells);
+    result |= cells;
+    return result;
+  }
+
+  // Returns the cells that are next to at least one of "cells".
+  CellSet Neighbors(const CellSet& cells) const {
+    CellSet result = cells;
+    result <<= 1;
+    CellSet shifted = cells;
+    shifted >>= 1;
+    result |= shifted;
+    shifted = cells;
+    shifted <<= stride();
+    result |= shifted;
+    shifted = cells;
+    shifted >>= stride();
+    result |= shifted;
+    return result;
+  }
+
+  // Returns the cells of "area" that are connected to "seeds" through
+  // "area". "seeds" must be cells of "area".
+  CellSet Reach(const CellSet& seeds, const CellSet& area) const;
+
+  // Gets, for each player, the empty cells that only reach the player's
+  // stones, given in "stones". Both arrays are indexed by color.
+  void GetAreas(const CellSet stones[3], CellSet only_reach[3]) const;
+
+  // Saves the state that every move may change into "undo".
+  void SaveState(UndoRecord* undo) const;
+
+  // Number of bytes Clone needs to copy.
+  size_t UsedBytes() const;
+
+  // Only read when N is 0, see width() and stride().
+  GoSizeT width_, height_;
+  GoSizeT stride_;
+
+  // The player who is going to play the next move.
+  GoColor current_player_;
+
+  // It is set when there is a ko situation, where current player is prohibited
+  // from capturing the opponent's stone on this cell. If there is no ko on
+  // the board, it is set to kNoCell.
+  Index ko_;
+
+  // Zobrist key of the position, see hash().
+  uint64_t hash_;
+
+  // Approximate points of each party, corresponding to unknown, black and
+  // white, respectively.
+  GoSizeT approx_territory_[3];
+
+  // Suicide positions of black and white, indexed by color - 1. If a player
+  // places a stone on one of such cells, it will end up with a chain with no
+  // liberties without capturing any opposing stones. Therefore, such move is
+  // prohibited. Both are kept up to date, so a pass changes nothing here.
+  CellSet forbidden_[2];
+
+  // Empty cells on the board.
+  CellSet empty_;
+
+  // Stones of black and white, indexed by color - 1, so scoring needs no
+  // walk over the chains.
+  CellSet player_stones_[2];
+
+  // See dirty().
+  bool track_dirty_;
+  CellSet dirty_;
+
+  // See pattern() and atari_flags().
+  bool track_patterns_;
+  uint16_t patterns_[kNumCells];
+  uint8_t atari_flags_[kNumCells];
+
+  uint8_t stones_[kNumCells];      // cell-to-stone map, see Index.
+  int16_t chain_ids_[kNumCells];   // cell-to-chain-id map.
+
+  // Chain IDs index chains_. Slots in [1, num_chain_slots_] have been used;
+  // the free ones among them are kept in free_chain_ids_ for reuse, so the
+  // used part of the pool stays as small as the number of live chains.
+  int16_t num_chain_slots_;
+  int16_t num_free_chain_ids_;
+  int16_t free_chain_ids_[kMaxNumChains];
+
+  // The chain pool. It must be the last member, see UsedBytes.
+  Chain chains_[kMaxNumChains + 1];
+};
+
+extern template class GoBoardT<0>;
+extern template class GoBoardT<9>;
+extern template class GoBoardT<13>;
+extern template class GoBoardT<19>;
+
+// Receives the GoBoardT<N> behind a GoBoard, for code that runs directly on the
+// rules core, see GoBoard::VisitCore.
+class GoBoardCoreVisitor {
+ public:
+  virtual ~GoBoardCoreVisitor() {}
+
+  virtual void Visit(const GoBoardT<0>& board) = 0;
+  virtual void Visit(const GoBoardT<9>& board) = 0;
+  virtual void Visit(const GoBoardT<13>& board) = 0;
+  virtual void Visit(const GoBoardT<19>& board) = 0;
+};
+
+// What GoBoard needs from a GoBoardT<N>, whatever N is. It is implemented in
+// go_game.cc and only used by GoBoard.
+class GoBoardCore {
+ public:
+  virtual ~GoBoardCore() {}
+
+  virtual std::unique_ptr<GoBoardCore> Clone() const = 0;
+
+  virtual GoColor current_player() const = 0;
+  virtual uint64_t hash() const = 0;
+  virtual GoColor GetStone(GoPosition pos) const = 0;
+  // Same as GoBoardT<N>, for a valid position.
+  virtual bool IsLegalMove(GoPosition pos) const = 0;
+  virtual uint64_t StonesHash() const = 0;
+  virtual uint64_t StonesHashAfterMove(GoPosition pos) const = 0;
+  // Writes LegalMoves() to "mask", in the order of GoBoard::Encode.
+  virtual void GetLegalMoves(std::vector<uint8_t>* mask) const = 0;
+
+  // Plays a stone or passes, see GoBoardT<N>. If "record_undo" is true, the
+  // move is pushed to the undo journal, which Undo pops.
+  virtual void Play(GoPosition pos, std::vector<GoPosition>* captured_stones,
+                    bool record_undo) = 0;
+  virtual void Pass(bool record_undo) = 0;
+  virtual void Undo() = 0;
+
+  // Writes, for every position in the order of GoBoard::Encode, the player
+  // whose settled area holds it, see GoBoardT<N>::GetPassAlive.
+  virtual void GetPassAlive(std::vector<GoColor>* owners) const = 0;
+
+  // See GoBoardT<N>::AreaScore. Settled areas are found first if
+  // "count_settled" is true.
+  virtual int AreaScore(bool count_settled) const = 0;
+
+  virtual void EstimateTerritory() = 0;
+  virtual void ClearTerritory() = 0;
+  virtual GoSizeT approx_territory(int i) const = 0;
+
+  // See GoBoard::ReadTactics and GoBoard::ReadChain, without superko.
+  // "moves" has room for width * height bytes.
+  virtual void ReadTactics(int max_nodes, uint8_t* moves) = 0;
+  virtual TacticalStatus ReadChain(GoPosition pos, int max_nodes) = 0;
+
+  // Computes all feature planes for current player, then turns on dirty-cell
+  // tracking.
+  virtual void RebuildFeatures(GoFeatureSet* features) = 0;
+  // Rewrites the dirty cells for current player.
+  virtual void UpdateDirtyFeatures(GoFeatureSet* features) = 0;
+  virtual void StopTrackingDirty() = 0;
+
+  // Keeps the stones of the last "length" positions in a ring, cleared here.
+  // Play and Pass push the position they leave; Undo drops the newest one.
+  virtual void SetHistoryLength(int length) = 0;
+  // Writes the history bits of "features" for current player, see
+  // GoFeatureSet. Positions older than the ring holds are empty.
+  virtual void WriteHistoryFeatures(GoFeatureSet* features) const = 0;
+
+  virtual std::string DebugString(bool output_chains) const = 0;
+
+  // Calls visitor->Visit with the GoBoardT<N>.
+  virtual void Accept(GoBoardCoreVisitor* visitor) const = 0;
+};
+
 class GoBoard {
  public:
   explicit GoBoard(GoSizeT size) : GoBoard(size, size) {}
+  // 9*9, 13*13 and 19*19 boards run on their own GoBoardT<N>.
   GoBoard(GoSizeT width, GoSizeT height);
-  ~GoBoard() {}
+  ~GoBoard();
 
   // Deep copy.
   std::unique_ptr<GoBoard> Clone() const;
@@ -72,16 +567,31 @@ class GoBoard {
   GoSizeT height() const { return height_; }
 
   // The player who is going to play the next move.
-  GoColor current_player() const { return current_player_; }
+  GoColor current_player() const { return core_->current_player(); }
 
   // Gets the stone color of a position.
-  GoColor GetStone(GoPosition pos) const {
-    return stones_[Encode(pos)];
-  }
+  GoColor GetStone(GoPosition pos) const { return core_->GetStone(pos); }
 
   // Checks if the move is legal for current player.
   bool IsLegalMove(GoPosition move) const;
 
+  // Gets the legal moves of current player except pass and resign, as a mask
+  // of width * height bytes in the order of Encode, so it lines up with the
+  // policy output: 1 if the move is legal, 0 otherwise. It is cached until
+  // the board changes, so like GetFeatures it is not thread-safe.
+  const std::vector<uint8_t>& GetLegalMoves() const;
+
+  // 64-bit Zobrist key of the current position. Besides the stones, it covers
+  // the player to move and the ko point, so two boards with the same key are
+  // interchangeable for search with overwhelming probability.
+  uint64_t hash() const { return core_->hash(); }
+
+  // Turns on the positional superko rule: from now on, a move is illegal if
+  // the resulting arrangement of stones has occurred on this board since the
+  // rule was enabled. Off by default, in which case only simple ko applies.
+  void EnablePositionalSuperko();
+  bool positional_superko() const { return positional_superko_; }
+
   // Current player plays at the position. Dead stones of the opponent caused
   // by this move will be put to "captured_stones", if it is not null.
   // estimate_territory is optional, run it only when necessary because
@@ -92,14 +602,85 @@ class GoBoard {
     return Move(move, false, captured_stones);
   }
 
+  // Turns on the undo journal: from now on, every pass or stone move records
+  // what it changed, so that Undo can take it back. A resignation doesn't
+  // change the board and records nothing. Off by default.
+  void EnableUndo() { undo_enabled_ = true; }
+  bool undo_enabled() const { return undo_enabled_; }
+
+  // Number of moves Undo can take back.
+  int num_undoable_moves() const { return added_to_history_.size(); }
+
+  // Takes back the last recorded move and restores the previous state
+  // exactly, including the feature planes. Returns false if there is nothing
+  // to undo.
+  bool Undo();
+
+  // Reads ladders and one-move captures for current player, with at most
+  // "max_nodes" moves played in the reading, see TacticalReaderT. Writes one
+  // byte per position in the order of Encode: kTacticalCapture is set if the
+  // move captures an opponent chain, at once or in a ladder, and
+  // kTacticalEscape if it saves a chain of current player in atari from
+  // being captured. Search can use them to prune moves, e.g. extending a
+  // chain that the ladder catches anyway. Superko is not checked.
+  // The reading plays on a scratch board shared with GetFeatures, so like
+  // GetFeatures it is not thread-safe, even though it is const.
+  void ReadTactics(int max_nodes, std::vector<uint8_t>* moves) const;
+
+  // Reads the chain on "pos", with current player to move and at most
+  // "max_nodes" moves played. Not thread-safe, like ReadTactics.
+  TacticalStatus ReadChain(GoPosition pos, int max_nodes) const;
+
+  // Adds the "capture" and "escape" planes to the feature set, which hold
+  // the kTacticalCapture and kTacticalEscape flags of ReadTactics. They are
+  // read again, within "max_nodes", for every new position GetFeatures sees.
+  void EnableTacticalFeatures(int max_nodes);
+  bool tactical_features() const { return tactics_max_nodes_ > 0; }
+
+  // Adds the stones of the last "num_positions" positions to the feature
+  // set, at most GoFeatureSet::kMaxHistory. The board keeps them in a ring of
+  // bitboards that every Move feeds, so it costs a copy of the stones per
+  // move instead of a board per position. Positions before this call, and
+  // the oldest one after an Undo, are empty.
+  void EnableHistoryFeatures(int num_positions);
+  int history_features() const { return history_length_; }
+
   // Gets current feature set, which will be used by machine learning models
-  // to compute the next move for current player.
-  const GoFeatureSet& GetFeatures() const { return *features_; }
+  // to compute the next move for current player. The planes are computed on
+  // the first call and cached, then brought up to date on the next call after
+  // the board changes. So it is not thread-safe, even though it is const.
+  const GoFeatureSet& GetFeatures() const;
+
+  // Drops the feature planes for good, for boards that only need the rules.
+  // GetFeatures must not be called afterwards.
+  void DisableFeatures();
+  bool features_enabled() const { return features_enabled_; }
+
+  // Gets, for every position in the order of Encode, the player whose
+  // unconditionally alive stones or settled territory hold it, or COLOR_NONE.
+  // Moves in a settled area don't change the outcome, so search can skip
+  // them, and a game where every position is settled is decided. It runs
+  // Benson's algorithm on demand.
+  void GetPassAlive(std::vector<GoColor>* owners) const {
+    core_->GetPassAlive(owners);
+  }
+
+  // Area score by Tromp-Taylor rules, black minus white, without komi. With
+  // "count_settled", the settled areas of GetPassAlive count for their owner,
+  // so dead stones in them don't need to be captured first.
+  int AreaScore(bool count_settled = false) const {
+    return core_->AreaScore(count_settled);
+  }
+
+  // Black's lead at the end of the game: the area score, settled areas
+  // counted, minus komi.
+  float FinalScore(float komi) const { return AreaScore(true) - komi; }
 
   // Gets estimated territory of each player. 0: shared; 1: black; 2: white.
   std::tuple<GoSizeT, GoSizeT, GoSizeT> GetApproxPoints() const {
-    return std::make_tuple(approx_territory_[0], approx_territory_[1],
-                           approx_territory_[2]);
+    return std::make_tuple(core_->approx_territory(0),
+                           core_->approx_territory(1),
+                           core_->approx_territory(2));
   }
 
   // Encodes a board coordinate to an integer in [0, width * height).
@@ -116,165 +697,190 @@ class GoBoard {
   }
 
   // Prints a readable string for debugging.
-  std::string DebugString(bool output_chains) const;
+  std::string DebugString(bool output_chains) const {
+    return core_->DebugString(output_chains);
+  }
+
+  // Hands the rules core to "visitor". It knows nothing of superko, undo
+  // history or feature planes.
+  void VisitCore(GoBoardCoreVisitor* visitor) const { core_->Accept(visitor); }
 
  private:
   GoBoard() = delete;
 
-  struct GoChain {
-    GoChain(GoColor chain_color, int16_t id) : color(chain_color),
-                                               chain_id(id) {}
-    ~GoChain() {}
-
-    // Gets the first liberty.
-    GoPosition FirstLiberty() const {
-      DCHECK(!liberties.empty());
-      return *liberties.begin();
-    }
-
-    // Returns a deep copy.
-    std::unique_ptr<GoChain> Clone() const;
-
-    // Returns a readable string for debugging.
-    std::string DebugString() const;
-
-    const GoColor color;
-    const int16_t chain_id;
-    std::vector<GoPosition> stones;
-    std::set<GoPosition> liberties;
-  };
-
-  // Iterator class to loop over a position's neighbor coordinates.
-  struct NeighorIterator {
-    NeighorIterator(const GoBoard* b, GoPosition c);
-
-    // Moves to the next position.
-    NeighorIterator& operator++();
-
-    GoPosition operator* () const {
-      CHECK(!end()) << "Trying to read after reaching the end.";
-      return current;
-    }
-
-    bool end() const { return offset >= 4; }
-
-    const GoBoard* board;
-    GoPosition center;
-    GoPosition current;
-    int offset;
-  };
+  // Takes over a copy of another board's core, see Clone. The feature planes
+  // are left for the caller to fill.
+  GoBoard(GoSizeT width, GoSizeT height, std::unique_ptr<GoBoardCore> core);
 
   // Boundary check.
   bool IsValidPosition(GoPosition move) const {
-    return (move.first >= 0 && move.first < width() &&
-            move.second >= 0 && move.second < height());
-  }
-
-  void SetStone(GoPosition pos, GoColor color) {
-    stones_[Encode(pos)] = color;
+    return (move.first >= 0 && move.first < width_ &&
+            move.second >= 0 && move.second < height_);
   }
-  void SetChainId(GoPosition pos, int16_t chain_id) {
-    chains_[Encode(pos)] = chain_id;
-  }
-
-  // Gets the chain that occupies the position. Returns nullptr if there is no
-  // stone on the position.
-  GoChain* GetChain(GoPosition p) const;
-
-  // Gets the chains and liberties (unoccupied coordinates) that are adjacent
-  // to the position. Chains of current player will be returned in "neighbors"
-  // and chains of the opponent will be returned in "opponents". "liberties" is
-  // nullable, if caller doesn't care about liberties.
-  void GetAdjacentChains(GoPosition pos,
-                         std::set<GoChain*>* neighbors,
-                         std::set<GoChain*>* opponents,
-                         std::vector<GoPosition>* liberties) const;
-
-  // Removes the chain from the board and puts its stones in "deads".
-  void RemoveChain(const GoChain* c, std::vector<GoPosition>* deads);
-
-  // Creates a new chain with the stone which has the given liberties.
-  GoChain* CreateNewChain(GoPosition stone,
-                          const std::vector<GoPosition>& liberties);
-
-  // Merges the chains into one chain, where these chains must be able to be
-  // joined together by the stone. "liberties" are the joint stone's liberties.
-  void MergeChains(GoPosition joint, const std::vector<GoPosition>& liberties,
-                   std::set<GoChain*>* chains);
-
-  // Computes forbidden positions, a.k.a. suicide positions, for current player.
-  void UpdateForbiddenPositions();
 
-  // Computes the feature planes for current player.
-  void UpdateFeatureSet();
-
-  // Estimates terriotory for each player. Results can be accessed through
-  // GetApproxPoints.
-  void EstimateTerritory();
+  // Brings the feature planes up to date after a move or an undo. Only the
+  // dirty cells of the core are rewritten; when the player to move changes,
+  // "orig" is negated and the b* and w* planes trade places.
+  void UpdateFeatureSet() const;
 
   const GoSizeT width_, height_;
-
-  // The player who is going to play the next move.
-  GoColor current_player_;
-
-  std::vector<GoColor> stones_;   // coordinate-to-stone map.
-  std::vector<int16_t> chains_;   // coordinate-to-chain-id map.
-
-  // Map from chain ID to chain.
-  std::unordered_map<int16_t, std::unique_ptr<GoChain>> chain_map_;
-
-  // Next unused chain ID.
-  int16_t next_chain_id_;
-
-  // It is set when there is a ko situation, where current player is prohibited
-  // from capturing the opponent's stone at this position. If there is no ko on
-  // the board, it is set to kNPos.
-  GoPosition ko_;
-
-  // Suicide positions. If current player places a stone on one of such
-  // positions, it will end up with a chain with no liberties without capturing
-  // any opposing stones. Therefore, such move is prohibited.
-  std::set<GoPosition> forbidden_positions_;
-
-  // Feature set for current player.
-  std::unique_ptr<GoFeatureSet> features_;
-
-  // Approximate points of each party. The size of this vector is always 3,
-  // corresponding to unknown, black and white, respectively.
-  std::vector<GoSizeT> approx_territory_;
+  std::unique_ptr<GoBoardCore> core_;
+
+  // Set by EnablePositionalSuperko. "position_history_" holds StonesHash() of
+  // every position since then.
+  bool positional_superko_ = false;
+  std::unordered_set<uint64_t> position_history_;
+
+  // Set by EnableUndo. The core keeps the undo journal; this tells, for every
+  // recorded move, if it added its position to position_history_.
+  bool undo_enabled_ = false;
+  std::vector<bool> added_to_history_;
+
+  // Cache of GetLegalMoves, valid if "legal_moves_valid_" is set.
+  mutable bool legal_moves_valid_ = false;
+  mutable std::vector<uint8_t> legal_moves_;
+
+  // Feature set for "features_player_", who is current player once
+  // UpdateFeatureSet returns. It is a cache filled by GetFeatures, null until
+  // the first call.
+  bool features_enabled_ = true;
+  mutable std::unique_ptr<GoFeatureSet> features_;
+  mutable GoColor features_player_ = COLOR_NONE;
+
+  // Set by EnableTacticalFeatures, 0 if off. The tactical planes were read
+  // for the position whose hash() is "tactics_hash_".
+  int tactics_max_nodes_ = 0;
+  mutable uint64_t tactics_hash_ = 0;
+
+  // Set by EnableHistoryFeatures, 0 if off. The history planes need to be
+  // written again if "history_stale_" is set, after every Move and Undo.
+  int history_length_ = 0;
+  mutable bool history_stale_ = false;
 };
 
+// Feature planes of a position. "orig" is 1 for a stone of current player,
+// -1 for a stone of the opponent and 0 otherwise; b1..b3 (w1..w3) are 1 on the
+// stones of current player (the opponent) whose chain has 1..3 liberties. So
+// all the planes of a cell fit in one byte:
+//   bit p (0 <= p < 7): plane p is 1,
+//   bit 7:              "orig" is -1.
+// Cells go row by row. A feature set of a 19x19 board takes 361 bytes, so it
+// is cheap to clone and to keep in inference queues. ExpandTo turns it into
+// floats in the model's input layout only when a batch tensor is filled.
+//
+// With tactical planes, "capture" and "escape" follow as planes 7 and 8. They
+// live in a second byte per cell, which holds the flags of
+// GoBoard::ReadTactics.
+//
+// With a history of n positions, 2 * n planes come last: "b_hist<k>" and
+// "w_hist<k>" are 1 on the stones of current player and of the opponent k
+// moves ago, passes included. They live in a third byte per cell, with bits
+// 2k - 2 and 2k - 1 for position k, so n is at most kMaxHistory.
 class GoFeatureSet {
  public:
-  GoFeatureSet(GoSizeT width, GoSizeT height);
+  GoFeatureSet(GoSizeT width, GoSizeT height, bool tactical_planes = false,
+               int num_history = 0);
 
   // Accessors.
-  int num_planes() const  { return planes_.size(); }
+  int num_planes() const {
+    return history_plane_base() + 2 * num_history_;
+  }
+  bool has_tactical_planes() const { return !tactical_cells_.empty(); }
+  int num_history() const { return num_history_; }
   GoSizeT width() const  { return width_; }
   GoSizeT height() const { return height_; }
-  const std::vector<float>& plane(int idx) const { return planes_[idx]; }
   std::string GetPlaneName(int idx) const;
 
+  // The packed cells, see the layout above.
+  const uint8_t* cells() const { return cells_.data(); }
+  uint8_t* mutable_cells() { return cells_.data(); }
+
+  // The tactical flags of the cells, only with tactical planes.
+  const uint8_t* tactical_cells() const { return tactical_cells_.data(); }
+  uint8_t* mutable_tactical_cells() { return tactical_cells_.data(); }
+
+  // The history bits of the cells, only with a history.
+  const uint8_t* history_cells() const { return history_cells_.data(); }
+  uint8_t* mutable_history_cells() { return history_cells_.data(); }
+
+  // Number of floats written by ExpandTo.
+  int expanded_size() const { return cells_.size() * num_planes(); }
+
+  // Writes all values as floats in NHWC order without the batch dimension:
+  // the value of plane p at (x,y) goes to
+  //   output[(y * width() + x) * num_planes() + p].
+  void ExpandTo(float* output) const;
+
+  // Gets the value at (x,y) of a plane.
+  float Get(int plane_id, GoSizeT x, GoSizeT y) const {
+    if (plane_id >= history_plane_base()) {
+      return (history_cells_[y * width_ + x] >>
+              (plane_id - history_plane_base())) & 1;
+    }
+    if (plane_id >= kNumPlanes) {
+      return (tactical_cells_[y * width_ + x] >> (plane_id - kNumPlanes)) & 1;
+    }
+    const uint8_t cell = cells_[y * width_ + x];
+    return ((cell >> plane_id) & 1) - (plane_id == 0 ? cell >> 7 : 0);
+  }
+
+  // Gathers the values of a plane, row by row. It is a copy, meant for tests
+  // and for exporting examples.
+  std::vector<float> plane(int idx) const;
+
   // Deep copy.
   void CopyFrom(const GoFeatureSet& other);
 
   std::unique_ptr<GoFeatureSet> Clone() const {
-    std::unique_ptr<GoFeatureSet> copy(new GoFeatureSet(width_, height_));
+    std::unique_ptr<GoFeatureSet> copy(new GoFeatureSet(
+        width_, height_, has_tactical_planes(), num_history_));
     copy->CopyFrom(*this);
     return copy;
   }
 
-  // Sets the value at (x,y) of a plane.
-  void Set(int plane_id, GoSizeT x, GoSizeT y, float value) {
-    planes_[plane_id][y * width_ + x] = value;
+  // Sets the value at (x,y) of a plane. Only "orig" may be -1, the values are
+  // 0 or 1 otherwise.
+  void Set(int plane_id, GoSizeT x, GoSizeT y, float value);
+
+  // Sets all the planes at (x,y) at once, as a packed cell.
+  void SetCell(GoSizeT x, GoSizeT y, uint8_t cell) {
+    cells_[y * width_ + x] = cell;
   }
 
+  // Multiplies all values of "orig" by -1. The other planes have no negative
+  // values.
+  void Negate(int plane_id);
+
+  // Exchanges the values of two planes other than "orig".
+  void SwapPlanes(int a, int b);
+
   // Resets all values to 0.
   void Reset();
 
+  // Number of packed planes, and of tactical planes when there are some.
+  static constexpr int kNumPlanes = 7;
+  static constexpr int kNumTacticalPlanes = 2;
+  // Most positions a history byte has room for.
+  static constexpr int kMaxHistory = 4;
+  // Bit of a packed cell that means "orig" is -1.
+  static constexpr uint8_t kNegativeOrig = 1 << 7;
+
  private:
+  // Exchanges bits a and b of every cell.
+  void SwapBits(int a, int b);
+
+  // Id of the first history plane.
+  int history_plane_base() const {
+    return kNumPlanes + (has_tactical_planes() ? kNumTacticalPlanes : 0);
+  }
+
   const GoSizeT width_, height_;
-  std::vector<std::vector<float>> planes_;
+  const int num_history_;
+  std::vector<uint8_t> cells_;
+  // Empty without tactical planes.
+  std::vector<uint8_t> tactical_cells_;
+  // Empty without a history.
+  std::vector<uint8_t> history_cells_;
 };
 
 }  // namespace zebra_go
@@ -1,6 +1,9 @@
 #include "engine/go_game.h"
 
+#include <random>
+
 #include "benchmark/benchmark.h"
+#include "engine/playout.h"
 #include "engine/sgf_utils.h"
 #include "sgf_parser/parser.h"
 
@@ -63,6 +66,126 @@ static void BM_ReplayGame(benchmark::State& state) {
 // 0: don't estimate territory; 1: estimate territory at every step.
 BENCHMARK(BM_ReplayGame)->Arg(0)->Arg(1);
 
+// Reads ladders and captures after every move of a game, with the node
+// budget given by the argument.
+static void BM_ReadTactics(benchmark::State& state) {
+  const std::string sgf = ReadFileToString("testdata/cj_supermatch_1991.sgf");
+  sgf_parser::GameRecord game;
+  std::string errors;
+  if (!sgf_parser::SimpleParseSgf(sgf, &game, nullptr, &errors)) {
+    LOG(FATAL) << "Failed in parsing SGF: " << errors;
+  }
+
+  std::vector<uint8_t> moves;
+  for (auto _ : state) {
+    GoBoard board(game.board_width, game.board_height);
+    for (const auto& m : game.moves) {
+      const GoColor player = (m.player == sgf_parser::GoMove::BLACK
+                                  ? COLOR_BLACK : COLOR_WHITE);
+      if (player != board.current_player()) {
+        board.Move(kMovePass, nullptr);
+      }
+      CHECK(board.Move(m.pass ? kMovePass : m.move, nullptr));
+      board.ReadTactics(state.range(0), &moves);
+      benchmark::DoNotOptimize(moves.data());
+    }
+  }
+  state.counters["moves"] = game.moves.size();
+}
+
+BENCHMARK(BM_ReadTactics)->Arg(100)->Arg(1000);
+
+// Scores the final position of a game, by Tromp-Taylor rules (0) or with
+// settled areas counted (1).
+static void BM_AreaScore(benchmark::State& state) {
+  const std::string sgf = ReadFileToString("testdata/cj_supermatch_1991.sgf");
+  sgf_parser::GameRecord game;
+  std::string errors;
+  if (!sgf_parser::SimpleParseSgf(sgf, &game, nullptr, &errors)) {
+    LOG(FATAL) << "Failed in parsing SGF: " << errors;
+  }
+  GoBoard board(game.board_width, game.board_height);
+  for (const auto& m : game.moves) {
+    const GoColor player = (m.player == sgf_parser::GoMove::BLACK
+                                ? COLOR_BLACK : COLOR_WHITE);
+    if (player != board.current_player()) {
+      board.Move(kMovePass, nullptr);
+    }
+    CHECK(board.Move(m.pass ? kMovePass : m.move, nullptr));
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(board.AreaScore(state.range(0)));
+  }
+}
+
+BENCHMARK(BM_AreaScore)->Arg(0)->Arg(1);
+
+// Scores the end of a random game, where most empty cells are single eyes,
+// as at the end of a playout. The rules core is called directly.
+static void BM_PlayoutEndScore(benchmark::State& state) {
+  GoBoardT<19> board(19, 19);
+  GoBoardT<19>::CellSet captured;
+  std::mt19937 rng(1);
+  int consecutive_passes = 0;
+  while (consecutive_passes < 2) {
+    // Neither fills an eye nor plays where all neighbors are opponents.
+    std::vector<GoBoardT<19>::Index> moves;
+    board.LegalMoves().ForEach([&board, &moves](GoBoardT<19>::Index idx) {
+      bool own = true, opponent = true;
+      for (const auto offset : board.neighbor_offsets()) {
+        const GoColor color = board.StoneAt(idx + offset);
+        own &= (color == board.current_player() || color == COLOR_OFF_BOARD);
+        opponent &= (color != board.current_player() && color != COLOR_NONE);
+      }
+      if (!own && !opponent) moves.push_back(idx);
+    });
+    if (moves.empty()) {
+      board.Pass(nullptr);
+      ++consecutive_passes;
+    } else {
+      board.Play(moves[rng() % moves.size()], &captured, nullptr);
+      consecutive_passes = 0;
+    }
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(board.AreaScore());
+  }
+}
+
+BENCHMARK(BM_PlayoutEndScore);
+
+// Light playouts from an empty board of the given size.
+static void BM_Playout(benchmark::State& state) {
+  GoBoard board(state.range(0));
+  PlayoutEngine playout(board, /*seed=*/1);
+  int64_t num_moves = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(playout.Run());
+    num_moves += playout.last_num_moves();
+  }
+  state.counters["moves/playout"] =
+      static_cast<double>(num_moves) / state.iterations();
+}
+
+BENCHMARK(BM_Playout)->Arg(9)->Arg(19);
+
+static void BM_PatternPlayout(benchmark::State& state) {
+  GoBoard board(state.range(0));
+  const PatternWeights weights;
+  PlayoutEngine playout(board, /*seed=*/1, &weights);
+  int64_t num_moves = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(playout.Run());
+    num_moves += playout.last_num_moves();
+  }
+  state.counters["moves/playout"] =
+      static_cast<double>(num_moves) / state.iterations();
+}
+
+BENCHMARK(BM_PatternPlayout)->Arg(9)->Arg(19);
+
 }  // namespace zebra_go
 
 BENCHMARK_MAIN();
@@ -1,5 +1,11 @@
 #include "engine/go_game.h"
 
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <random>
+#include <set>
+
 #include "engine/sgf_utils.h"
 #include "glog/logging.h"
 #include "gmock/gmock.h"
@@ -30,7 +36,60 @@ TEST(SerializationTest, EncodeDecode) {
   EXPECT_EQ(COLOR_WHITE, ColorFromString("w"));
 }
 
-class GoBoardTest : public ::testing::Test {};
+class GoBoardTest : public ::testing::Test {
+ protected:
+  // Plays "num_moves" random moves on "board", with "seed": a legal move
+  // picked uniformly, or a pass one time in 20 and when no move is legal.
+  // After each move, calls "after_move" with the number of moves played
+  // before it and the stones it captured.
+  static void PlayRandomMoves(
+      GoBoard* board, int num_moves, uint32_t seed, bool estimate_territory,
+      const std::function<void(int, const std::vector<GoPosition>&)>&
+          after_move) {
+    std::mt19937 rng(seed);
+    const GoSizeT num_cells = board->width() * board->height();
+    std::vector<GoPosition> legal_moves, captured;
+    for (int i = 0; i < num_moves; ++i) {
+      legal_moves.clear();
+      for (GoSizeT s = 0; s < num_cells; ++s) {
+        if (board->IsLegalMove(board->Decode(s))) {
+          legal_moves.push_back(board->Decode(s));
+        }
+      }
+      GoPosition move = kMovePass;
+      if (!legal_moves.empty() && rng() % 20 != 0) {
+        move = legal_moves[rng() % legal_moves.size()];
+      }
+      captured.clear();
+      ASSERT_TRUE(board->Move(move, estimate_territory, &captured));
+      after_move(i, captured);
+      if (HasFatalFailure()) return;
+    }
+  }
+
+  // The same on the rules core.
+  template <int N>
+  static void PlayRandomMoves(GoBoardT<N>* board, int num_moves,
+                              uint32_t seed,
+                              const std::function<void(int)>& after_move) {
+    std::mt19937 rng(seed);
+    std::vector<typename GoBoardT<N>::Index> legal_moves;
+    typename GoBoardT<N>::CellSet captured;
+    for (int i = 0; i < num_moves; ++i) {
+      legal_moves.clear();
+      board->LegalMoves().ForEach(
+          [&legal_moves](int idx) { legal_moves.push_back(idx); });
+      if (legal_moves.empty() || rng() % 20 == 0) {
+        board->Pass(nullptr);
+      } else {
+        board->Play(legal_moves[rng() % legal_moves.size()], &captured,
+                    nullptr);
+      }
+      after_move(i);
+      if (HasFatalFailure()) return;
+    }
+  }
+};
 
 TEST_F(GoBoardTest, Basic) {
   /*
@@ -214,6 +273,676 @@ TEST_F(GoBoardTest, ForbiddenMoves2) {
   EXPECT_FALSE(board.IsLegalMove({4,0}));
 }
 
+TEST_F(GoBoardTest, Hash) {
+  GoBoard a(9, 9), b(9, 9);
+  EXPECT_EQ(a.hash(), b.hash());
+  ASSERT_TRUE(a.Move({2, 2}, nullptr));
+  EXPECT_NE(a.hash(), b.hash());
+  ASSERT_TRUE(a.Move({6, 6}, nullptr));
+  ASSERT_TRUE(a.Move({2, 6}, nullptr));
+
+  // Same stones reached in a different order.
+  ASSERT_TRUE(b.Move({2, 6}, nullptr));
+  ASSERT_TRUE(b.Move({6, 6}, nullptr));
+  ASSERT_TRUE(b.Move({2, 2}, nullptr));
+  EXPECT_EQ(a.hash(), b.hash());
+  EXPECT_EQ(a.hash(), a.Clone()->hash());
+
+  // Same stones, different player to move.
+  ASSERT_TRUE(b.Move(kMovePass, nullptr));
+  EXPECT_NE(a.hash(), b.hash());
+}
+
+TEST_F(GoBoardTest, PositionalSuperko) {
+  /*
+        A B C D
+    04| X + X +|04
+    03| X X O O|03
+    02| + O O +|02
+    01| O + X O|01
+        A B C D
+    Black D4, White B4 (captures C4 and D4), Black C4 (captures B4) brings
+    back the stones of the initial position. It is not a simple ko because
+    White captured two stones.
+  */
+  static const char kSgf[] = R"((
+    ;GM[1]FF[4]CA[UTF-8]AP[test]SZ[4]
+    ;AB[ad][cd][ac][bc][ca]
+    ;AW[cc][dc][bb][cb][aa][da]
+  ))";
+  for (const bool superko : {false, true}) {
+    auto board = SgfToGoBoard(kSgf);
+    ASSERT_TRUE(board != nullptr);
+    if (board->current_player() != COLOR_BLACK) {
+      board->Move(kMovePass, nullptr);
+    }
+    if (superko) {
+      board->EnablePositionalSuperko();
+    }
+    const uint64_t initial_hash = board->hash();
+
+    std::vector<GoPosition> deads;
+    ASSERT_TRUE(board->Move({3, 3}, &deads));
+    EXPECT_TRUE(deads.empty());
+    ASSERT_TRUE(board->Move({1, 3}, &deads));
+    EXPECT_EQ(2, deads.size());
+    EXPECT_EQ(!superko, board->IsLegalMove({2, 3}));
+    EXPECT_EQ(!superko, board->GetLegalMoves()[board->Encode({2, 3})]);
+    if (!superko) {
+      ASSERT_TRUE(board->Move({2, 3}, &deads));
+      EXPECT_EQ(1, deads.size());
+      ASSERT_TRUE(board->Move(kMovePass, nullptr));
+      EXPECT_EQ(initial_hash, board->hash());
+    }
+  }
+}
+
+TEST_F(GoBoardTest, Undo) {
+  // Plays random moves, which include captures, merges, ko and passes, then
+  // takes them back one by one.
+  GoBoard board(9);
+  board.EnableUndo();
+  EXPECT_FALSE(board.Undo());
+
+  struct Snapshot {
+    std::string debug_string;
+    uint64_t hash;
+    std::vector<std::vector<float>> planes;
+  };
+  auto take_snapshot = [&board]() {
+    Snapshot snapshot{board.DebugString(true), board.hash(), {}};
+    const GoFeatureSet& features = board.GetFeatures();
+    for (int i = 0; i < features.num_planes(); ++i) {
+      snapshot.planes.push_back(features.plane(i));
+    }
+    return snapshot;
+  };
+
+  std::vector<Snapshot> snapshots = {take_snapshot()};
+  int num_captures = 0;
+  PlayRandomMoves(&board, 300, 1234, /*estimate_territory=*/true,
+                  [&](int, const std::vector<GoPosition>& captured) {
+    num_captures += captured.size();
+    snapshots.push_back(take_snapshot());
+  });
+  ASSERT_FALSE(HasFatalFailure());
+  EXPECT_GT(num_captures, 0);
+  EXPECT_EQ(300, board.num_undoable_moves());
+  // The position before every move, the last one first.
+  snapshots.pop_back();
+
+  while (!snapshots.empty()) {
+    ASSERT_TRUE(board.Undo());
+    const Snapshot snapshot = take_snapshot();
+    EXPECT_EQ(snapshots.back().debug_string, snapshot.debug_string);
+    EXPECT_EQ(snapshots.back().hash, snapshot.hash);
+    EXPECT_EQ(snapshots.back().planes, snapshot.planes);
+    snapshots.pop_back();
+  }
+  EXPECT_FALSE(board.Undo());
+}
+
+// A chain id freed by a capture and taken again by an undone move is still
+// free once the moves are taken back, even if a later move reused its slot in
+// the free list.
+TEST_F(GoBoardTest, UndoKeepsFreeChainIds) {
+  GoBoardT<0> board(5, 5);
+  GoBoardT<0>::CellSet captured;
+  for (const GoPosition& move : {GoPosition(0, 1), GoPosition(0, 0),
+                                 GoPosition(2, 0), GoPosition(4, 4),
+                                 GoPosition(3, 4), kMovePass,
+                                 GoPosition(1, 0)}) {
+    if (move == kMovePass) {
+      board.Pass(nullptr);
+    } else {
+      board.Play(board.ToIndex(move), &captured, nullptr);
+    }
+  }
+  // B1 joined C1 and captured A1, which freed a chain id; E5 is in atari.
+  GoBoardT<0>::UndoRecord undo_white, undo_black;
+  board.Play(board.ToIndex({2, 2}), &captured, &undo_white);
+  board.Play(board.ToIndex({4, 3}), &captured, &undo_black);  // Captures E5.
+  ASSERT_EQ(1, captured.Count());
+  board.Undo(undo_black);
+  board.Undo(undo_white);
+
+  const GoBoardT<0>::Index e5 = board.ToIndex({4, 4});
+  board.Play(board.ToIndex({2, 2}), &captured, nullptr);
+  ASSERT_NE(nullptr, board.GetChain(e5));
+  EXPECT_EQ(COLOR_WHITE, board.GetChain(e5)->color);
+  EXPECT_TRUE(board.GetChain(e5)->stones.Test(e5));
+}
+
+// A pass recorded into an UndoRecord that held a move must not undo the
+// chain changes of that move.
+TEST_F(GoBoardTest, UndoPassInReusedRecord) {
+  GoBoardT<0> board(5, 5);
+  GoBoardT<0>::CellSet captured;
+  for (const GoPosition& move : {GoPosition(0, 1), GoPosition(0, 0),
+                                 GoPosition(2, 0), GoPosition(4, 4),
+                                 GoPosition(3, 4), kMovePass,
+                                 GoPosition(1, 0)}) {
+    if (move == kMovePass) {
+      board.Pass(nullptr);
+    } else {
+      board.Play(board.ToIndex(move), &captured, nullptr);
+    }
+  }
+  // A1 was captured, so C3 takes its freed chain id, which is the last one.
+  const GoBoardT<0>::Index c3 = board.ToIndex({2, 2});
+  GoBoardT<0>::UndoRecord undo;
+  board.Play(c3, &captured, &undo);
+  board.Undo(undo);
+  board.Play(c3, &captured, nullptr);
+  board.Pass(&undo);
+  board.Undo(undo);
+
+  EXPECT_EQ(COLOR_BLACK, board.current_player());
+  ASSERT_NE(nullptr, board.GetChain(c3));
+  EXPECT_EQ(COLOR_WHITE, board.GetChain(c3)->color);
+  board.Play(board.ToIndex({4, 3}), &captured, nullptr);  // Captures E5.
+  EXPECT_EQ(1, captured.Count());
+  const GoBoardT<0>::Index a5 = board.ToIndex({0, 4});
+  board.Play(a5, &captured, nullptr);  // Takes the id freed by E5.
+  ASSERT_NE(nullptr, board.GetChain(a5));
+  EXPECT_NE(board.GetChain(c3), board.GetChain(a5));
+  EXPECT_TRUE(board.GetChain(c3)->stones.Test(c3));
+}
+
+TEST_F(GoBoardTest, Features) {
+  // Plays random moves and checks the feature planes, which are updated
+  // incrementally, against ones computed from the stones. Also checks that
+  // GetLegalMoves agrees with IsLegalMove.
+  GoBoard board(9);
+  const GoSizeT size = board.width();
+  PlayRandomMoves(&board, 300, 4321, /*estimate_territory=*/false,
+                  [&](int i, const std::vector<GoPosition>&) {
+    for (GoSizeT s = 0; s < size * size; ++s) {
+      ASSERT_EQ(board.IsLegalMove(board.Decode(s)), board.GetLegalMoves()[s]);
+    }
+
+    std::vector<std::vector<float>> expected(
+        7, std::vector<float>(size * size, 0.0f));
+    std::vector<bool> visited(size * size, false);
+    for (GoSizeT s = 0; s < size * size; ++s) {
+      const GoColor color = board.GetStone(board.Decode(s));
+      if (color == COLOR_NONE || visited[s]) continue;
+      // Floodfill the chain and count its liberties.
+      std::vector<GoSizeT> chain = {s}, stack = {s};
+      std::set<GoSizeT> liberties;
+      visited[s] = true;
+      while (!stack.empty()) {
+        const GoPosition pos = board.Decode(stack.back());
+        stack.pop_back();
+        for (const GoPosition& d : std::vector<GoPosition>{
+                 {-1, 0}, {1, 0}, {0, -1}, {0, 1}}) {
+          const GoPosition n(pos.first + d.first, pos.second + d.second);
+          if (n.first < 0 || n.first >= size || n.second < 0 ||
+              n.second >= size) {
+            continue;
+          }
+          const GoSizeT code = board.Encode(n);
+          if (board.GetStone(n) == COLOR_NONE) {
+            liberties.insert(code);
+          } else if (board.GetStone(n) == color && !visited[code]) {
+            visited[code] = true;
+            chain.push_back(code);
+            stack.push_back(code);
+          }
+        }
+      }
+      const bool own = (color == board.current_player());
+      for (const GoSizeT stone : chain) {
+        expected[0][stone] = own ? 1 : -1;
+        if (liberties.size() >= 1 && liberties.size() <= 3) {
+          expected[liberties.size() + (own ? 0 : 3)][stone] = 1;
+        }
+      }
+    }
+    for (int pid = 0; pid < 7; ++pid) {
+      ASSERT_EQ(expected[pid], board.GetFeatures().plane(pid))
+          << board.GetFeatures().GetPlaneName(pid) << " after " << i
+          << " moves.\n" << board.DebugString(false);
+    }
+  });
+}
+
+// Plays the same random moves on GoBoardT<N> and the general GoBoardT<0>,
+// and expects the same positions.
+template <int N>
+void ExpectSameAsGeneralBoard() {
+  GoBoardT<N> board(N, N);
+  GoBoardT<0> general(N, N);
+  std::mt19937 rng(N);
+  for (int i = 0; i < 2 * N * N; ++i) {
+    std::vector<GoPosition> legal_moves;
+    for (GoSizeT x = 0; x < N; ++x) {
+      for (GoSizeT y = 0; y < N; ++y) {
+        const bool legal = board.IsLegalMove(board.ToIndex({x, y}));
+        ASSERT_EQ(legal, general.IsLegalMove(general.ToIndex({x, y})));
+        if (legal) {
+          legal_moves.push_back({x, y});
+        }
+      }
+    }
+    if (legal_moves.empty() || rng() % 20 == 0) {
+      board.Pass(nullptr);
+      general.Pass(nullptr);
+    } else {
+      const GoPosition move = legal_moves[rng() % legal_moves.size()];
+      typename GoBoardT<N>::CellSet captured;
+      GoBoardT<0>::CellSet general_captured;
+      board.Play(board.ToIndex(move), &captured, nullptr);
+      general.Play(general.ToIndex(move), &general_captured, nullptr);
+      ASSERT_EQ(captured.Count(), general_captured.Count());
+    }
+    ASSERT_EQ(board.hash(), general.hash());
+    ASSERT_EQ(board.DebugString(true), general.DebugString(true));
+  }
+}
+
+TEST(GoFeatureSetTest, PackedCells) {
+  GoFeatureSet features(3, 2);
+  ASSERT_EQ(7, features.num_planes());
+  ASSERT_EQ(3 * 2 * 7, features.expanded_size());
+  features.Set(0, 2, 1, 1);
+  features.Set(1, 2, 1, 1);
+  features.Set(0, 0, 1, -1);
+  features.Set(4, 0, 1, 1);
+  EXPECT_EQ(0x03, features.cells()[1 * 3 + 2]);
+  EXPECT_EQ(0x90, features.cells()[1 * 3 + 0]);
+  EXPECT_EQ(-1, features.Get(0, 0, 1));
+  EXPECT_EQ(std::vector<float>({0, 0, 0, -1, 0, 1}), features.plane(0));
+
+  // All planes of a cell are adjacent once expanded.
+  std::vector<float> expanded(features.expanded_size(), 42);
+  features.ExpandTo(expanded.data());
+  for (int i = 0; i < 6; ++i) {
+    for (int pid = 0; pid < 7; ++pid) {
+      EXPECT_EQ(features.Get(pid, i % 3, i / 3), expanded[i * 7 + pid]);
+    }
+  }
+
+  features.Negate(0);
+  features.SwapPlanes(1, 4);
+  EXPECT_EQ(std::vector<float>({0, 0, 0, 1, 0, -1}), features.plane(0));
+  EXPECT_EQ(std::vector<float>({0, 0, 0, 1, 0, 0}), features.plane(1));
+  EXPECT_EQ(std::vector<float>({0, 0, 0, 0, 0, 1}), features.plane(4));
+
+  auto copy = features.Clone();
+  EXPECT_TRUE(std::equal(features.cells(), features.cells() + 6,
+                         copy->cells()));
+}
+
+TEST(GoFeatureSetTest, TacticalPlanes) {
+  GoFeatureSet features(3, 2, /*tactical_planes=*/true);
+  ASSERT_EQ(9, features.num_planes());
+  ASSERT_EQ(3 * 2 * 9, features.expanded_size());
+  EXPECT_EQ("capture", features.GetPlaneName(7));
+  EXPECT_EQ("escape", features.GetPlaneName(8));
+  features.Set(0, 1, 0, -1);
+  features.Set(6, 2, 1, 1);
+  features.Set(7, 1, 0, 1);
+  features.Set(8, 1, 0, 1);
+  features.Set(8, 2, 1, 1);
+  features.Set(8, 1, 0, 0);
+  EXPECT_EQ(kTacticalCapture, features.tactical_cells()[1]);
+  EXPECT_EQ(kTacticalEscape, features.tactical_cells()[5]);
+
+  std::vector<float> expanded(features.expanded_size(), 42);
+  features.ExpandTo(expanded.data());
+  for (int i = 0; i < 6; ++i) {
+    for (int pid = 0; pid < 9; ++pid) {
+      EXPECT_EQ(features.Get(pid, i % 3, i / 3), expanded[i * 9 + pid]);
+    }
+  }
+  EXPECT_EQ(std::vector<float>({0, 1, 0, 0, 0, 0}), features.plane(7));
+  EXPECT_EQ(features.plane(8), features.Clone()->plane(8));
+}
+
+TEST(GoFeatureSetTest, HistoryPlanes) {
+  GoFeatureSet features(3, 2, /*tactical_planes=*/true, /*num_history=*/2);
+  ASSERT_EQ(13, features.num_planes());
+  ASSERT_EQ(3 * 2 * 13, features.expanded_size());
+  EXPECT_EQ("escape", features.GetPlaneName(8));
+  EXPECT_EQ("b_hist1", features.GetPlaneName(9));
+  EXPECT_EQ("w_hist1", features.GetPlaneName(10));
+  EXPECT_EQ("w_hist2", features.GetPlaneName(12));
+  features.Set(0, 1, 0, -1);
+  features.Set(7, 1, 0, 1);
+  features.Set(10, 1, 0, 1);
+  features.Set(9, 2, 1, 1);
+  features.Set(12, 2, 1, 1);
+  features.Set(9, 2, 1, 0);
+  EXPECT_EQ(2, features.history_cells()[1]);
+  EXPECT_EQ(8, features.history_cells()[5]);
+
+  std::vector<float> expanded(features.expanded_size(), 42);
+  features.ExpandTo(expanded.data());
+  for (int i = 0; i < 6; ++i) {
+    for (int pid = 0; pid < 13; ++pid) {
+      EXPECT_EQ(features.Get(pid, i % 3, i / 3), expanded[i * 13 + pid]);
+    }
+  }
+  EXPECT_EQ(std::vector<float>({0, 0, 0, 0, 0, 1}), features.plane(12));
+  EXPECT_EQ(features.plane(10), features.Clone()->plane(10));
+
+  // Without tactical planes, the history comes right after the packed ones.
+  GoFeatureSet short_history(3, 2, /*tactical_planes=*/false,
+                             /*num_history=*/1);
+  ASSERT_EQ(9, short_history.num_planes());
+  EXPECT_EQ("b_hist1", short_history.GetPlaneName(7));
+  short_history.Set(8, 0, 1, 1);
+  std::vector<float> short_expanded(short_history.expanded_size(), 42);
+  short_history.ExpandTo(short_expanded.data());
+  EXPECT_EQ(1, short_expanded[3 * 9 + 8]);
+  EXPECT_EQ(0, short_expanded[3 * 9 + 7]);
+}
+
+// The history planes hold the stones of the previous positions, as seen by
+// current player, through moves, passes, undos and copies.
+TEST_F(GoBoardTest, HistoryFeatures) {
+  const int kHistory = 3;
+  GoBoard board(9);
+  board.EnableUndo();
+  board.EnableHistoryFeatures(kHistory);
+  std::mt19937 rng(20);
+  auto stones = [&board]() {
+    std::vector<GoColor> colors(81);
+    for (int i = 0; i < 81; ++i) colors[i] = board.GetStone(board.Decode(i));
+    return colors;
+  };
+  // The stones of the previous positions, the newest first. An undo forgets
+  // the position it goes back to, without bringing back the oldest one.
+  std::deque<std::vector<GoColor>> history;
+  for (int i = 0; i < 100; ++i) {
+    const GoFeatureSet& features = board.GetFeatures();
+    ASSERT_EQ(GoFeatureSet::kNumPlanes + 2 * kHistory, features.num_planes());
+    const GoColor player = board.current_player();
+    for (int k = 0; k < kHistory; ++k) {
+      const int plane = GoFeatureSet::kNumPlanes + 2 * k;
+      for (int s = 0; s < 81; ++s) {
+        const GoColor color = k < static_cast<int>(history.size())
+                                  ? history[k][s]
+                                  : COLOR_NONE;
+        const GoPosition pos = board.Decode(s);
+        ASSERT_EQ(color == player, features.Get(plane, pos.first, pos.second))
+            << "k=" << k << " after " << i << " moves.";
+        ASSERT_EQ(color == GetOpponent(player),
+                  features.Get(plane + 1, pos.first, pos.second))
+            << "k=" << k << " after " << i << " moves.";
+      }
+    }
+    if (board.num_undoable_moves() > 0 && rng() % 8 == 0) {
+      ASSERT_TRUE(board.Undo());
+      if (!history.empty()) history.pop_front();
+      continue;
+    }
+    history.push_front(stones());
+    if (history.size() > kHistory) history.pop_back();
+    const GoPosition move(rng() % 9, rng() % 9);
+    ASSERT_TRUE(board.Move(board.IsLegalMove(move) ? move : kMovePass,
+                           nullptr));
+  }
+  auto copy = board.Clone();
+  EXPECT_EQ(kHistory, copy->history_features());
+  for (int pid = 0; pid < 2 * kHistory; ++pid) {
+    EXPECT_EQ(board.GetFeatures().plane(GoFeatureSet::kNumPlanes + pid),
+              copy->GetFeatures().plane(GoFeatureSet::kNumPlanes + pid));
+  }
+}
+
+// The tactical planes always hold what ReadTactics finds.
+TEST_F(GoBoardTest, TacticalFeatures) {
+  const int kMaxNodes = 500;
+  GoBoard board(9);
+  board.EnableTacticalFeatures(kMaxNodes);
+  std::vector<uint8_t> moves;
+  PlayRandomMoves(&board, 120, 17, /*estimate_territory=*/false,
+                  [&](int i, const std::vector<GoPosition>&) {
+    const GoFeatureSet& features = board.GetFeatures();
+    ASSERT_EQ(9, features.num_planes());
+    board.ReadTactics(kMaxNodes, &moves);
+    ASSERT_TRUE(std::equal(moves.begin(), moves.end(),
+                           features.tactical_cells()))
+        << "after " << i << " moves.\n" << board.DebugString(false);
+  });
+  ASSERT_FALSE(HasFatalFailure());
+  auto copy = board.Clone();
+  EXPECT_TRUE(copy->tactical_features());
+  EXPECT_EQ(board.GetFeatures().plane(7), copy->GetFeatures().plane(7));
+}
+
+TEST_F(GoBoardTest, ForbiddenPositionsAfterRandomMoves) {
+  // The forbidden positions are kept up to date incrementally. Check them
+  // against the definition, for both players, after every move.
+  typedef GoBoardT<9> Board;
+  Board board(9, 9);
+  int num_forbidden = 0;
+  PlayRandomMoves(&board, 400, 99, [&](int i) {
+    for (const bool other_player : {false, true}) {
+      std::unique_ptr<Board> b = board.Clone();
+      if (other_player) {
+        b->Pass(nullptr);
+      }
+      const GoColor player = b->current_player();
+      for (GoSizeT x = 0; x < 9; ++x) {
+        for (GoSizeT y = 0; y < 9; ++y) {
+          const Board::Index idx = b->ToIndex({x, y});
+          bool own_in_atari = false, own_not_in_atari = false;
+          bool opponent_in_atari = false, has_liberty = false;
+          for (const GoPosition& n : std::vector<GoPosition>{
+                   {x - 1, y}, {x + 1, y}, {x, y - 1}, {x, y + 1}}) {
+            if (!b->IsValidPosition(n)) continue;
+            const Board::Chain* chain = b->GetChain(b->ToIndex(n));
+            if (chain == nullptr) {
+              has_liberty = true;
+            } else if (chain->color == player) {
+              (chain->HasOneLiberty() ? own_in_atari : own_not_in_atari) = true;
+            } else if (chain->HasOneLiberty()) {
+              opponent_in_atari = true;
+            }
+          }
+          const bool expected = b->StoneAt(idx) == COLOR_NONE &&
+                                !has_liberty && own_in_atari &&
+                                !own_not_in_atari && !opponent_in_atari;
+          ASSERT_EQ(expected, b->forbidden().Test(idx))
+              << ToString(GoPosition(x, y)) << " after " << i << " moves.\n"
+              << b->DebugString(false);
+          num_forbidden += expected;
+        }
+      }
+    }
+  });
+  ASSERT_FALSE(HasFatalFailure());
+  EXPECT_GT(num_forbidden, 0);
+}
+
+TEST_F(GoBoardTest, EstimateTerritory) {
+  // Checks the estimation against a floodfill of every empty region, on a
+  // board that is not square.
+  GoBoard board(7, 11);
+  const GoSizeT num_cells = board.width() * board.height();
+  PlayRandomMoves(&board, 150, 7, /*estimate_territory=*/true,
+                  [&](int i, const std::vector<GoPosition>&) {
+    int points[3] = {0, 0, 0};  // unknown, black, white
+    int num_stones = 0;
+    std::vector<bool> visited(num_cells, false);
+    for (GoSizeT s = 0; s < num_cells; ++s) {
+      const GoColor color = board.GetStone(board.Decode(s));
+      if (color != COLOR_NONE) {
+        ++points[color];
+        ++num_stones;
+        continue;
+      }
+      if (visited[s]) continue;
+      bool borders[3] = {false, false, false};
+      int size = 0;
+      std::vector<GoSizeT> stack = {s};
+      visited[s] = true;
+      while (!stack.empty()) {
+        const GoPosition pos = board.Decode(stack.back());
+        stack.pop_back();
+        ++size;
+        for (const GoPosition& d : std::vector<GoPosition>{
+                 {-1, 0}, {1, 0}, {0, -1}, {0, 1}}) {
+          const GoPosition n(pos.first + d.first, pos.second + d.second);
+          if (n.first < 0 || n.first >= board.width() || n.second < 0 ||
+              n.second >= board.height()) {
+            continue;
+          }
+          const GoColor c = board.GetStone(n);
+          borders[c] = true;
+          if (c == COLOR_NONE && !visited[board.Encode(n)]) {
+            visited[board.Encode(n)] = true;
+            stack.push_back(board.Encode(n));
+          }
+        }
+      }
+      if (borders[COLOR_BLACK] == borders[COLOR_WHITE]) {
+        points[0] += size;
+      } else {
+        points[borders[COLOR_BLACK] ? COLOR_BLACK : COLOR_WHITE] += size;
+      }
+    }
+    EXPECT_EQ(points[COLOR_BLACK] - points[COLOR_WHITE], board.AreaScore())
+        << "after " << i << " moves.\n" << board.DebugString(false);
+    if (num_stones < 11) {
+      return;  // Not estimated at the beginning of the game.
+    }
+    EXPECT_EQ(std::make_tuple(points[0], points[1], points[2]),
+              board.GetApproxPoints())
+        << "after " << i << " moves.\n" << board.DebugString(false);
+  });
+}
+
+TEST_F(GoBoardTest, SpecializedBoards) {
+  ExpectSameAsGeneralBoard<9>();
+  ExpectSameAsGeneralBoard<13>();
+  ExpectSameAsGeneralBoard<19>();
+}
+
+// Plays random moves, some taken back, with patterns tracked, and expects the
+// same patterns as computing them from scratch, and the stones of each player
+// where StoneAt has them.
+template <int N>
+void ExpectPatternsUpToDate(GoSizeT size) {
+  typedef GoBoardT<N> Board;
+  Board board(size, size);
+  board.set_track_patterns(true);
+  std::mt19937 rng(size);
+  std::vector<typename Board::UndoRecord> undo_records;
+  for (int i = 0; i < 4 * size * size; ++i) {
+    if (!undo_records.empty() && rng() % 10 == 0) {
+      board.Undo(undo_records.back());
+      undo_records.pop_back();
+      continue;
+    }
+    std::vector<typename Board::Index> legal_moves;
+    board.LegalMoves().ForEach(
+        [&legal_moves](int idx) { legal_moves.push_back(idx); });
+    undo_records.emplace_back();
+    if (legal_moves.empty() || rng() % 20 == 0) {
+      board.Pass(&undo_records.back());
+    } else {
+      typename Board::CellSet captured;
+      board.Play(legal_moves[rng() % legal_moves.size()], &captured,
+                 &undo_records.back());
+    }
+
+    auto expected = board.Clone();
+    expected->set_track_patterns(true);
+    for (GoSizeT x = 0; x < size; ++x) {
+      for (GoSizeT y = 0; y < size; ++y) {
+        const auto idx = board.ToIndex({x, y});
+        ASSERT_EQ(expected->pattern(idx), board.pattern(idx))
+            << ToString(GoPosition(x, y)) << " after " << i << " moves.\n"
+            << board.DebugString(false);
+        ASSERT_EQ(expected->atari_flags(idx), board.atari_flags(idx))
+            << ToString(GoPosition(x, y)) << " after " << i << " moves.\n"
+            << board.DebugString(false);
+        for (const GoColor player : {COLOR_BLACK, COLOR_WHITE}) {
+          ASSERT_EQ(board.StoneAt(idx) == player,
+                    board.stones(player).Test(idx))
+              << ToString(GoPosition(x, y)) << " after " << i << " moves.";
+        }
+      }
+    }
+  }
+}
+
+TEST_F(GoBoardTest, Patterns) {
+  GoBoardT<0> board(3, 3);
+  board.set_track_patterns(true);
+  // Only empty cells around the center. Around the corner A1, cells 0 to 3
+  // (the row below and the left) and 5 (upper left) are off the board.
+  EXPECT_EQ(0, board.pattern(board.ToIndex({1, 1})));
+  EXPECT_EQ(0x0cff, board.pattern(board.ToIndex({0, 0})));
+
+  typename GoBoardT<0>::CellSet captured;
+  board.Play(board.ToIndex({1, 0}), &captured, nullptr);  // black B1
+  board.Play(board.ToIndex({0, 0}), &captured, nullptr);  // white A1
+  const auto a2 = board.ToIndex({0, 1});
+  // B1 is cell 4 (to the right) of A1, and cell 2 (lower right) of A2.
+  EXPECT_EQ(COLOR_BLACK, (board.pattern(board.ToIndex({0, 0})) >> 8) & 3);
+  EXPECT_EQ(COLOR_BLACK, (board.pattern(a2) >> 4) & 3);
+  EXPECT_EQ(COLOR_WHITE, (board.pattern(a2) >> 2) & 3);
+  // White A1 is in atari, and it is neighbor 0 (below) of A2.
+  EXPECT_EQ(1, board.atari_flags(a2));
+
+  ExpectPatternsUpToDate<0>(7);
+  ExpectPatternsUpToDate<9>(9);
+}
+
+TEST_F(GoBoardTest, PassAlive) {
+  // Black wall on columns A and B with two eyes: A5, and A2-A3 where a white
+  // stone on A2 is dead. Every empty cell of the right side isn't next to
+  // black, so it is not settled.
+  const std::vector<GoPosition> black = {{0, 0}, {1, 0}, {1, 1}, {1, 2},
+                                         {1, 3}, {0, 3}, {1, 4}};
+  GoBoardT<0> board(5, 5);
+  typename GoBoardT<0>::CellSet captured;
+  board.Pass(nullptr);
+  board.Play(board.ToIndex({0, 1}), &captured, nullptr);
+  for (const GoPosition& pos : black) {
+    board.Play(board.ToIndex(pos), &captured, nullptr);
+    board.Pass(nullptr);
+  }
+  typename GoBoardT<0>::CellSet alive[3];
+  board.GetPassAlive(alive);
+  EXPECT_TRUE(alive[COLOR_WHITE].Empty());
+  EXPECT_EQ(10, alive[COLOR_BLACK].Count());
+  for (const GoPosition& pos : {GoPosition(0, 1), GoPosition(0, 2),
+                                GoPosition(0, 4), GoPosition(1, 4)}) {
+    EXPECT_TRUE(alive[COLOR_BLACK].Test(board.ToIndex(pos))) << ToString(pos);
+  }
+  // By Tromp-Taylor, white A2 counts for white and A3 for no one.
+  EXPECT_EQ(22, board.AreaScore());
+  EXPECT_EQ(25, board.AreaScore(alive));
+
+  // Without B5, the wall has a single eye and nothing is settled.
+  GoBoard one_eye(5);
+  ASSERT_TRUE(one_eye.Move(kMovePass, nullptr));
+  ASSERT_TRUE(one_eye.Move({0, 1}, nullptr));
+  for (size_t i = 0; i + 1 < black.size(); ++i) {
+    ASSERT_TRUE(one_eye.Move(black[i], nullptr));
+    ASSERT_TRUE(one_eye.Move(kMovePass, nullptr));
+  }
+  std::vector<GoColor> owners;
+  one_eye.GetPassAlive(&owners);
+  ASSERT_EQ(25u, owners.size());
+  for (const GoColor owner : owners) EXPECT_EQ(COLOR_NONE, owner);
+
+  ASSERT_TRUE(one_eye.Move(black.back(), nullptr));
+  one_eye.GetPassAlive(&owners);
+  EXPECT_EQ(COLOR_BLACK, owners[one_eye.Encode({0, 1})]);
+  EXPECT_EQ(COLOR_BLACK, owners[one_eye.Encode({1, 4})]);
+  EXPECT_EQ(COLOR_NONE, owners[one_eye.Encode({2, 2})]);
+  EXPECT_EQ(22, one_eye.AreaScore());
+  EXPECT_EQ(25, one_eye.AreaScore(/*count_settled=*/true));
+  EXPECT_FLOAT_EQ(17.5, one_eye.FinalScore(7.5));
+}
+
 // Test the function ReplayGame in sgf_utils.
 TEST_F(GoBoardTest, ReplayGame) {
   const std::string sgf = ReadFileToString("testdata/shusai_19000415.sgf");
@@ -226,6 +955,18 @@ TEST_F(GoBoardTest, ReplayGame) {
         LOG(INFO) << ctx.num_steps;
       },
       [](std::unique_ptr<GoBoard> board) {});
+
+  // Without feature planes.
+  int num_steps = 0;
+  EXPECT_TRUE(ReplayGame(
+      sgf,
+      [](const ReplayContext& ctx) {
+        return !ctx.board->features_enabled();
+      },
+      [&num_steps](const ReplayContext& ctx) { num_steps = ctx.num_steps; },
+      [](std::unique_ptr<GoBoard> board) {},
+      false));
+  EXPECT_GT(num_steps, 0);
 }
 
 }  // namespace
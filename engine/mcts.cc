@@ -1,7 +1,10 @@
 #include "engine/mcts.h"
 
 #include <algorithm>
+#include <cmath>
+#include <memory>
 #include <thread>
+#include <type_traits>
 
 #include "absl/synchronization/mutex.h"
 #include "glog/logging.h"
@@ -10,13 +13,32 @@ namespace zebra_go {
 namespace {
 
 // Parameters:
-static const int kMaxSearchDepth = 2;
-static const int kMaxRollouts = 100;
+// Weight of the exploration term of PUCT.
+static const float kPuctExploration = 1.5f;
+// Positions sent to the scorer and not back yet. Enough to fill two batches
+// of TfScorer, so that one fills while the other runs.
+static const int kMaxInFlight = 256;
+
+void AtomicAdd(std::atomic<float>* target, float value) {
+  float old = target->load(std::memory_order_relaxed);
+  while (!target->compare_exchange_weak(old, old + value,
+                                        std::memory_order_relaxed)) {
+  }
+}
 
 }  // namespace
 
+struct MctsEdge;
+
+// A position of the tree. Nodes hold no board: a rollout gets the position
+// of a node by replaying the moves on its path from the root. The
+// statistics of a node are those of the edge that leads to it.
+//
+// Fields but "state" are written once, by the thread that scores the node,
+// before it stores STATE_SCORED or STATE_FAILED in "state", and only read
+// after a thread loads one of these states from it.
 struct MctsNode {
-  enum NodeState {
+  enum NodeState : uint8_t {
     // A new node.
     STATE_NEW = 0,
     // The node is being scored by AsyncScorer. Don't score it again.
@@ -27,104 +49,125 @@ struct MctsNode {
     STATE_FAILED = 3,
   };
 
-  // Guard everything of this node.
-  absl::Mutex mutex;
-  NodeState state = STATE_NEW;
-  MctsNode* parent = nullptr;          // Null if it is a root.
-  int depth = 0;
-  int visit_count = 0;
+  std::atomic<NodeState> state{STATE_NEW};
+  // Current player should resign.
+  bool resign = false;
+  int16_t num_edges = 0;
+  GoColor player = COLOR_NONE;         // Current player of the position.
+  // A combination of the value network's output and GoBoard.GetApproxPoints,
+  // for current player.
+  float value = 0;
+  // The moves worth searching, one per entry of the policy but those in
+  // settled areas, next to each other in the arena.
+  MctsEdge* edges = nullptr;
+
+  std::string DebugString(bool with_detail=false) const;
+};
 
-  std::unique_ptr<GoBoard> board;
-  std::map<GoPosition, MctsNode*> children;
-  // Evaluation result of the policy network.
-  PolicyResult candidate_moves;
-  // A combination of the value network's output and GoBoard.GetApproxPoints.
-  ValueResult score;
-  // Among all the leaf nodes under this node, the number of leaves where
-  // black/white wins. 0: black, 1: white
-  int win_count[2];
-
-  MctsNode(std::unique_ptr<GoBoard> game_state, MctsNode* parent_node)
-      : parent(parent_node),
-        board(std::move(game_state)) {
-    if (parent == nullptr) {
-      depth = 0;
-    } else {
-      depth = parent->depth + 1;
-    }
-    win_count[0] = 0;
-    win_count[1] = 0;
+// A move from a node, with its statistics for the player who plays it. The
+// child node is created by the first rollout that goes through the move.
+struct MctsEdge {
+  GoPosition move;
+  // Probability of the move in the policy of the node.
+  float prior = 0;
+  // Rollouts that went through the move and backed up a result.
+  std::atomic<int> visit_count{0};
+  // Rollouts that are going through the move and have not backed up yet.
+  // They count as losses, so that other threads try other moves meanwhile.
+  std::atomic<int> virtual_loss{0};
+  // Sum of the shares of the wins of the rollouts through the move.
+  std::atomic<float> total_value{0};
+  std::atomic<MctsNode*> child{nullptr};
+
+  // Mean value of the move, virtual losses included, or "unvisited" if no
+  // rollout went through it.
+  float MeanValue(float unvisited) const {
+    const int total = visit_count.load(std::memory_order_relaxed) +
+                      virtual_loss.load(std::memory_order_relaxed);
+    return total > 0 ? total_value.load(std::memory_order_relaxed) / total
+                     : unvisited;
   }
+};
 
-  // Returns true if
-  bool IsLeaf() {
-    absl::MutexLock lock(&mutex);
-    CHECK(state != STATE_NEW && state != STATE_SCORING);
-    if (state == STATE_FAILED) return true;
-    if (candidate_moves.empty()) return true;
-    if (score.first) return true;  // current player should resign.
-    return false;
+std::string MctsNode::DebugString(bool with_detail) const {
+  std::string result;
+  absl::StrAppend(&result, "state=", state.load(), "\t");
+  absl::StrAppend(&result, "#edges=", num_edges, "\t");
+  absl::StrAppend(&result, "resign=", resign, "\t");
+  absl::StrAppend(&result, "value=", value, "\t");
+  if (with_detail) {
+    absl::StrAppend(&result, "Edges: ");
+    for (int i = 0; i < num_edges; ++i) {
+      absl::StrAppend(&result, ToString(edges[i].move), ":",
+                      edges[i].prior, ":", edges[i].visit_count.load(), "; ");
+    }
   }
+  return result;
+}
 
-  // Current player should pass.
-  bool ShouldPass() {
-    absl::MutexLock lock(&mutex);
-    CHECK(state != STATE_NEW && state != STATE_SCORING);
-    return state == STATE_FAILED || candidate_moves.empty();
+// Owns the nodes and edges of a tree. They are carved out of large blocks,
+// so creating them costs a lock and a pointer bump instead of a heap
+// allocation, and the whole tree goes away with one free per block: nodes
+// and edges are trivially destructible.
+//
+// The class is thread-safe.
+class MctsArena {
+ public:
+  MctsArena() {}
+
+  // Returns "count" value-initialized objects in a row.
+  template <typename T>
+  T* New(int count) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "The arena runs no destructor.");
+    T* items = static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+    for (int i = 0; i < count; ++i) {
+      new (items + i) T();
+    }
+    return items;
   }
 
-  // Current player should resign.
-  bool ShouldResign() {
-    absl::MutexLock lock(&mutex);
-    CHECK(state != STATE_NEW && state != STATE_SCORING);
-    return state == STATE_SCORED && score.first;
-  }
+ private:
+  // Bytes in a block, unless a single allocation needs more.
+  static const size_t kBlockSize = 1 << 20;
 
-  void CollectRolloutResults() {
-    {
-      absl::MutexLock lock(&mutex);
-      CHECK(state != STATE_NEW && state != STATE_SCORING);
-    }
-    if (children.empty()) {
-      bool current_player_wins = true;
-      if (ShouldResign()) {
-        current_player_wins = false;
-      }
-      bool black_wins = (current_player_wins ==
-                         (board->current_player() == COLOR_BLACK));
-      win_count[0] = black_wins ? 1 : 0;
-      win_count[1] = black_wins ? 0 : 1;
-    } else {
-      for (auto iter : children) {
-        MctsNode* node = iter.second;
-        node->CollectRolloutResults();
-        win_count[0] += node->win_count[0];
-        win_count[1] += node->win_count[1];
-      }
-    }
-  }
+  void* Allocate(size_t size, size_t alignment);
 
-  std::string DebugString(bool with_detail=false) const {
-    std::string result;
-    absl::StrAppend(&result, "state=", state, "\t");
-    absl::StrAppend(&result, "#children=", children.size(), "\t");
-    absl::StrAppend(&result, "depth=", depth, "\t");
-    absl::StrAppend(&result, "#visits=", visit_count, "\t");
-    absl::StrAppend(&result, "wins=", win_count[0], ", ", win_count[1], "\t");
-    absl::StrAppend(&result, "score=", AsyncScorer::DebugString(score), "\t");
-    if (with_detail) {
-      absl::StrAppend(&result, "Candidate moves: ");
-      for (const auto& move : candidate_moves) {
-        absl::StrAppend(&result, ToString(move.first), ":", move.second, "; ");
-      }
-      absl::StrAppend(&result, "\tChildren: ");
-      for (const auto& iter : children) {
-        absl::StrAppend(&result, ToString(iter.first), ":",
-                        AsyncScorer::DebugString(iter.second->score), "; ");
-      }
-    }
-    return result;
+  absl::Mutex mutex_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  // The free part of the last block.
+  char* next_ = nullptr;
+  char* end_ = nullptr;
+};
+
+const size_t MctsArena::kBlockSize;
+
+void* MctsArena::Allocate(size_t size, size_t alignment) {
+  absl::MutexLock lock(&mutex_);
+  const uintptr_t address = reinterpret_cast<uintptr_t>(next_);
+  char* start = next_ + ((alignment - address % alignment) % alignment);
+  if (next_ == nullptr || start + size > end_) {
+    // The rest of the last block is left unused. New blocks are aligned for
+    // any type.
+    const size_t block_size = std::max(size, kBlockSize);
+    blocks_.emplace_back(new char[block_size]);
+    start = blocks_.back().get();
+    end_ = start + block_size;
   }
+  next_ = start + size;
+  return start;
+}
+
+// A rollout waiting for the scorer to score its last node.
+struct PendingEvaluation {
+  MctsNode* node = nullptr;
+  // The edges from the root down to "node", starting with the root edge.
+  std::vector<MctsEdge*> path;
+  // Position of "node", which the scorer reads until it calls back.
+  std::unique_ptr<GoBoard> board;
+  bool success = false;
+  PolicyResult candidate_moves;
+  ValueResult score;
 };
 
 // The class is thread-safe.
@@ -153,139 +196,322 @@ std::string MctsStats::DebugString() {
 }
 
 std::string MonteCarloSearchTree::SearchResult::DebugString() const {
-  return "";
+  std::string result = absl::StrCat("#rollouts=", num_rollouts, "\t",
+                                    "#nodes=", num_nodes, "\t");
+  for (const auto& move : moves) {
+    absl::StrAppend(&result, ToString(move.first), ":", move.second, "; ");
+  }
+  return result;
 }
 
 MonteCarloSearchTree::MonteCarloSearchTree(std::unique_ptr<GoBoard> board,
                                           int num_threads, AsyncScorer* scorer)
     :  num_threads_(num_threads),
        scorer_(scorer),
+       arena_(new MctsArena()),
        search_stats_(new MctsStats()) {
   CHECK_GT(num_threads, 0);
   CHECK(scorer_ != nullptr);
 
-  rollout_points_.reserve(400);
-  root_ = new MctsNode(std::move(board), /*parent_node=*/nullptr);
+  root_board_ = std::move(board);
+  root_edge_ = arena_->New<MctsEdge>(1);
+  root_ = NewNode(root_board_->current_player());
+  root_edge_->child.store(root_);
+}
+
+// No rollout is in flight once Search returns, so the arena can take the
+// whole tree away.
+MonteCarloSearchTree::~MonteCarloSearchTree() {}
+
+MctsNode* MonteCarloSearchTree::NewNode(GoColor player) {
+  MctsNode* node = arena_->New<MctsNode>(1);
+  node->player = player;
+  num_nodes_.fetch_add(1, std::memory_order_relaxed);
+  return node;
+}
+
+void MonteCarloSearchTree::ExpandNode(MctsNode* node, const GoBoard& board,
+                                      bool success,
+                                      const PolicyResult& candidate_moves,
+                                      const ValueResult& score) {
+  std::vector<std::pair<GoPosition, float>> moves;
+  if (success && !candidate_moves.empty() && !score.first) {
+    // Moves in settled areas change nothing, so they are not searched.
+    std::vector<GoColor> settled;
+    board.GetPassAlive(&settled);
+    for (const std::pair<GoPosition, float>& move : candidate_moves) {
+      if (move.first != kMovePass && move.first != kMoveResign &&
+          settled[board.Encode(move.first)] != COLOR_NONE) {
+        search_stats_->LogEvent("settled_move_skipped");
+        continue;
+      }
+      if (!board.IsLegalMove(move.first)) {
+        LOG(WARNING) << "The scorer returns an illegal move.";
+        continue;
+      }
+      moves.push_back(move);
+    }
+  }
+
+  if (!moves.empty()) {
+    MctsEdge* edges = arena_->New<MctsEdge>(moves.size());
+    float prior_sum = 0;
+    for (const std::pair<GoPosition, float>& move : moves) {
+      prior_sum += move.second;
+    }
+    for (size_t i = 0; i < moves.size(); ++i) {
+      edges[i].move = moves[i].first;
+      // The skipped moves leave their share to the others.
+      edges[i].prior = prior_sum > 0 ? moves[i].second / prior_sum
+                                     : 1.0f / moves.size();
+    }
+    node->edges = edges;
+    node->num_edges = moves.size();
+  }
+  node->resign = score.first;
+  node->value = score.second;
+  // Other threads read the edges once they see the new state.
+  node->state.store(success ? MctsNode::STATE_SCORED : MctsNode::STATE_FAILED,
+                    std::memory_order_release);
+}
+
+MctsEdge* MonteCarloSearchTree::SelectEdge(const MctsNode* node,
+                                           const MctsEdge* parent_edge) {
+  // PUCT, from the point of view of current player of "node": the mean value
+  // of a move plus a bonus in proportion to its prior, which fades as the
+  // move gets visits. A move nobody has gone through yet is worth the mean
+  // value of "node" itself. One pass over the edges, which lie in a row.
+  const int node_total =
+      parent_edge->visit_count.load(std::memory_order_relaxed) +
+      parent_edge->virtual_loss.load(std::memory_order_relaxed);
+  const float unvisited = 1 - parent_edge->MeanValue(/*unvisited=*/0.5f);
+  const float exploration =
+      kPuctExploration * std::sqrt(static_cast<float>(std::max(1, node_total)));
+  MctsEdge* best = nullptr;
+  float best_value = -1;
+  for (int i = 0; i < node->num_edges; ++i) {
+    MctsEdge* edge = node->edges + i;
+    const int total = edge->visit_count.load(std::memory_order_relaxed) +
+                      edge->virtual_loss.load(std::memory_order_relaxed);
+    const float value = edge->MeanValue(unvisited) +
+                        exploration * edge->prior / (1 + total);
+    if (value > best_value) {
+      best_value = value;
+      best = edge;
+    }
+  }
+  return best;
+}
+
+bool MonteCarloSearchTree::StartRollout() {
+  // Select: goes down from the root, adding a virtual loss on the way, until
+  // a node that has not been scored, or has no edges. The moves are played
+  // on a copy of the root position as they are picked.
+  std::unique_ptr<GoBoard> board = root_board_->Clone();
+  std::vector<MctsEdge*> path = {root_edge_};
+  root_edge_->virtual_loss.fetch_add(1, std::memory_order_relaxed);
+  MctsNode* node = root_;
+  bool score = false;
+  while (true) {
+    MctsNode::NodeState state = node->state.load(std::memory_order_acquire);
+    if (state == MctsNode::STATE_NEW) {
+      score = node->state.compare_exchange_strong(
+          state, MctsNode::STATE_SCORING, std::memory_order_relaxed);
+      break;
+    }
+    if (state != MctsNode::STATE_SCORED || node->num_edges == 0) break;
+
+    MctsEdge* edge = SelectEdge(node, path.back());
+    edge->virtual_loss.fetch_add(1, std::memory_order_relaxed);
+    path.push_back(edge);
+    MctsNode* child = edge->child.load(std::memory_order_acquire);
+    if (child == nullptr) {
+      MctsNode* new_child = NewNode(GetOpponent(node->player));
+      // Another thread may have created the child meanwhile; then the new
+      // one stays unused in the arena.
+      if (edge->child.compare_exchange_strong(child, new_child,
+                                              std::memory_order_acq_rel)) {
+        child = new_child;
+      }
+    }
+    // Territory is estimated on the position that will be scored only.
+    const bool leaf =
+        child->state.load(std::memory_order_relaxed) == MctsNode::STATE_NEW;
+    CHECK(board->Move(edge->move, /*estimate_territory=*/leaf, nullptr))
+        << "Illegal move " << ToString(edge->move) << " in the tree.";
+    node = child;
+  }
+  if (!score) {
+    return BackUp(path, node);
+  }
 
-  // setup search threads
-  // for (int i = 0; i < num_threads; ++i) {
-  // search_threads_.emplace_back(&MonteCarloSearchTree::SearchThread, this, i);
-  // }
+  // Evaluate: the scorer batches the positions of many rollouts, so the
+  // rollout is finished by a search thread once the result is queued.
+  {
+    absl::MutexLock lock(&queue_mutex_);
+    ++num_in_flight_;
+  }
+  PendingEvaluation* evaluation = new PendingEvaluation();
+  evaluation->node = node;
+  evaluation->path.swap(path);
+  evaluation->board = std::move(board);
+  scorer_->ScoreGoState(
+      *evaluation->board,
+      [this, evaluation](bool success, PolicyResult candidate_moves,
+                         ValueResult score) {
+        evaluation->success = success;
+        evaluation->candidate_moves.swap(candidate_moves);
+        evaluation->score = score;
+        absl::MutexLock lock(&queue_mutex_);
+        scored_.emplace_back(evaluation);
+      });
+  return true;
 }
 
-MonteCarloSearchTree::~MonteCarloSearchTree() {
+void MonteCarloSearchTree::FinishRollout(
+    std::unique_ptr<PendingEvaluation> evaluation) {
+  if (!evaluation->success) search_stats_->LogEvent("scoring_failed");
+  ExpandNode(evaluation->node, *evaluation->board, evaluation->success,
+             evaluation->candidate_moves, evaluation->score);
+  BackUp(evaluation->path, evaluation->node);
+  absl::MutexLock lock(&queue_mutex_);
+  --num_in_flight_;
 }
 
-void MonteCarloSearchTree::SyncScoreNode(MctsNode* node) {
-  if (scorer_->SyncScoreGoState(*node->board,
-                                &node->candidate_moves,
-                                &node->score)) {
-    node->state = MctsNode::STATE_SCORED;
-  } else {
-    node->state = MctsNode::STATE_FAILED;
+bool MonteCarloSearchTree::BackUp(const std::vector<MctsEdge*>& path,
+                                  const MctsNode* leaf) {
+  const MctsNode::NodeState state = leaf->state.load(std::memory_order_acquire);
+  const bool success = (state == MctsNode::STATE_SCORED);
+  if (state == MctsNode::STATE_SCORING) {
+    search_stats_->LogEvent("rollout_collision");
   }
-  if (node->IsLeaf()) {
-    return;
+  // Share of the win that goes to current player of the leaf. The value is
+  // in [-1, 1] for current player, who loses by resigning.
+  float player_wins = 0;
+  if (success && !leaf->resign) {
+    player_wins = std::min(1.0f, std::max(0.0f, (leaf->value + 1) / 2));
   }
 
-  for (const std::pair<GoPosition, float>& move : node->candidate_moves) {
-    std::unique_ptr<GoBoard> state = node->board->Clone();
-    std::vector<GoPosition> deads;
-    if (!state->Move(move.first, /*estimate_territory=*/true, &deads)) {
-      LOG(WARNING) << "The scorer returns an illegal move.";
-      continue;
+  // Every move on the path gets the share of the player who played it. The
+  // last move was played by the opponent of current player of the leaf, and
+  // the players alternate up the path, as every edge, a pass included, is
+  // one move.
+  for (size_t i = 0; i < path.size(); ++i) {
+    MctsEdge* edge = path[path.size() - 1 - i];
+    if (success) {
+      edge->visit_count.fetch_add(1, std::memory_order_relaxed);
+      AtomicAdd(&edge->total_value, i % 2 == 0 ? 1 - player_wins
+                                                : player_wins);
+    }
+    edge->virtual_loss.fetch_sub(1, std::memory_order_relaxed);
+  }
+  return success;
+}
+
+bool MonteCarloSearchTree::HasWork() const {
+  return !scored_.empty() || num_in_flight_ < kMaxInFlight;
+}
+
+bool MonteCarloSearchTree::HasScoredOrDrained() const {
+  return !scored_.empty() || num_in_flight_ == 0;
+}
+
+void MonteCarloSearchTree::SearchThread(absl::Time deadline) {
+  // Finishing scored rollouts comes first, so that their results reach the
+  // tree before new rollouts are selected. New rollouts start while fewer
+  // than kMaxInFlight positions are out, until the deadline; then the
+  // rollouts in flight are finished, since the callbacks point into the tree.
+  while (true) {
+    std::unique_ptr<PendingEvaluation> evaluation;
+    {
+      absl::MutexLock lock(&queue_mutex_);
+      if (absl::Now() < deadline) {
+        queue_mutex_.AwaitWithDeadline(
+            absl::Condition(this, &MonteCarloSearchTree::HasWork), deadline);
+      }
+      if (scored_.empty() && absl::Now() >= deadline) {
+        queue_mutex_.Await(
+            absl::Condition(this, &MonteCarloSearchTree::HasScoredOrDrained));
+        if (scored_.empty()) return;
+      }
+      if (!scored_.empty()) {
+        evaluation = std::move(scored_.front());
+        scored_.pop_front();
+      }
+    }
+    if (evaluation != nullptr) {
+      FinishRollout(std::move(evaluation));
+    } else if (!StartRollout()) {
+      // The rollout ran into a node that is not scored, most likely one
+      // another rollout is scoring. Instead of selecting the same path again
+      // at once, wait for a scored rollout, or for none to be in flight.
+      absl::MutexLock lock(&queue_mutex_);
+      queue_mutex_.AwaitWithDeadline(
+          absl::Condition(this, &MonteCarloSearchTree::HasScoredOrDrained),
+          deadline);
     }
-    MctsNode* child = new MctsNode(std::move(state), node);
-    node->children[move.first] = child;
   }
 }
 
 MonteCarloSearchTree::SearchResult MonteCarloSearchTree::Search(
     absl::Duration time_limit) {
+  const absl::Time deadline = absl::Now() + time_limit;
   SearchResult result;
 
-  // Search the first two levels synchronously
-  // Level 0:
+  // The root decides alone whether to search at all.
   LOG(INFO) << "Score root node:";
-  SyncScoreNode(root_);
+  MctsNode::NodeState state = MctsNode::STATE_NEW;
+  CHECK(root_->state.compare_exchange_strong(state, MctsNode::STATE_SCORING))
+      << "Search runs once.";
+  PolicyResult candidate_moves;
+  ValueResult score;
+  const bool success =
+      scorer_->SyncScoreGoState(*root_board_, &candidate_moves, &score);
+  ExpandNode(root_, *root_board_, success, candidate_moves, score);
   LOG(INFO) << "root" << root_->DebugString();
-  if (root_->ShouldPass()) {
+  if (!success || candidate_moves.empty()) {
     result.moves.push_back(std::make_pair(kMovePass, 0));
     return result;
-  } else if (root_->ShouldResign()) {
+  } else if (score.first) {
     result.moves.push_back(std::make_pair(kMoveResign, 0));
     return result;
+  } else if (root_->num_edges == 0) {
+    // Every candidate move is in a settled area, so nothing is left to
+    // search.
+    result.moves.push_back(std::make_pair(kMovePass, 0));
+    return result;
   }
-  // Level 1:
-  for (auto iter : root_->children) {
-    SyncScoreNode(iter.second);
-    LOG(INFO) << "Child " << iter.second->DebugString();
-    for (auto child_iter : iter.second->children) {
-      rollout_points_.push_back(child_iter.second);
-    }
+
+  // Tree parallelism: every thread runs rollouts on the shared tree until
+  // the deadline, with up to kMaxInFlight of them waiting for the scorer.
+  for (int i = 0; i < num_threads_; ++i) {
+    search_threads_.emplace_back(&MonteCarloSearchTree::SearchThread, this,
+                                 deadline);
   }
-  LOG(INFO) << "points " << rollout_points_.size();
-
-  // Rollout and wait
-  for (MctsNode* node : rollout_points_) {
-    if (scorer_->SyncScoreGoState(*node->board,
-                                  &node->candidate_moves,
-                                  &node->score)) {
-      node->state = MctsNode::STATE_SCORED;
-    } else {
-      node->state = MctsNode::STATE_FAILED;
-    }
+  for (std::thread& thread : search_threads_) {
+    thread.join();
   }
-
-  LOG(INFO) << "All leaf nodes are scored.";
-
-  // std::this_thread::sleep_for(absl::ToChronoMilliseconds(time_limit));
-
-  // Finalize:
-  root_->CollectRolloutResults();
-  LOG(INFO) << "Collect done.";
-  for (MctsNode* node : rollout_points_) {
-    if (node->IsLeaf()) {
-      node->score.second = 1;  // TODO
-    } else {
-      float total = node->win_count[0] + node->win_count[1];
-      float prob_black_wins = 0.5;
-      if (total > 0) {
-        prob_black_wins = node->win_count[0] / total;
-      } else {
-        LOG(WARNING) << "0 rollouts for this node";
-      }
-      if (node->board->current_player() == COLOR_BLACK) {
-        node->score.second = prob_black_wins;
-      } else {
-        node->score.second = 1 - prob_black_wins;
-      }
-    }
+  search_threads_.clear();
+  LOG(INFO) << search_stats_->DebugString();
+
+  // The most visited moves first, each with the rate at which current player
+  // won the rollouts through it.
+  std::vector<const MctsEdge*> edges;
+  for (int i = 0; i < root_->num_edges; ++i) {
+    edges.push_back(root_->edges + i);
   }
-
-  // Select the best:
-  LOG(INFO) << root_->DebugString(true);
-  result.num_rollouts = root_->win_count[0] + root_->win_count[1];
-  for (auto iter : root_->children) {
-    MctsNode* node = iter.second;
-    float max_child_score = -1;
-    for (auto child_iter : node->children) {
-      if (child_iter.second->score.second > max_child_score) {
-        max_child_score = child_iter.second->score.second;
-      }
-    }
-    node->score.second = 1 - max_child_score;
-    result.moves.push_back(std::make_pair(iter.first, node->score.second));
+  std::stable_sort(edges.begin(), edges.end(),
+                   [](const MctsEdge* a, const MctsEdge* b) {
+                     return a->visit_count.load() > b->visit_count.load();
+                   });
+  for (const MctsEdge* edge : edges) {
+    result.moves.push_back(
+        std::make_pair(edge->move, edge->MeanValue(/*unvisited=*/0)));
   }
+  // Rollouts that collided backed up nothing, so they are not counted.
+  result.num_rollouts = root_edge_->visit_count.load();
+  result.num_nodes = num_nodes_.load();
   LOG(INFO) << root_->DebugString(true);
-
-  // Sort
-  std::sort(result.moves.begin(), result.moves.end(),
-            [](const std::pair<GoPosition, float>& a,
-               const std::pair<GoPosition, float>& b) {
-              return a.second > b.second;
-            });
-
   return result;
 }
 
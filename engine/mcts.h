@@ -3,6 +3,8 @@
 
 #include "engine/go_game.h"
 
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <string>
 #include <thread>
@@ -15,9 +17,28 @@
 
 namespace zebra_go {
 
+struct MctsEdge;
 struct MctsNode;
+class MctsArena;
 class MctsStats;
+struct PendingEvaluation;
 
+// Tree-parallel Monte Carlo search. Every thread repeatedly runs a rollout
+// on the shared tree: it selects a path from the root by PUCT, on the priors
+// of the scorer's policy, scores the new node at the end of it with the
+// AsyncScorer, which also expands it, and backs up the value of the node
+// into the statistics of every move along the path. A rollout on its way
+// adds a virtual loss to every node of its path, so the threads spread over
+// different nodes. The tree grows as deep as the time allows.
+//
+// Nodes keep no board, and their moves lie in a row with their statistics,
+// so a node takes a few dozen bytes plus one edge per searched move. A
+// rollout replays its path on a copy of the root position.
+//
+// Threads don't wait for the scorer: they hand it the position and go on
+// with other rollouts, so that many positions are scored in the same batch.
+// The scorer's callback queues the result, and a search thread finishes the
+// rollout from the queue.
 class MonteCarloSearchTree {
  public:
   MonteCarloSearchTree(std::unique_ptr<GoBoard> board, int num_threads,
@@ -27,24 +48,69 @@ class MonteCarloSearchTree {
   struct SearchResult {
     std::vector<std::pair<GoPosition, float>> moves;
     int num_rollouts = 0;
+    // Size of the tree.
+    int num_nodes = 0;
 
     std::string DebugString() const;
   };
 
+  // Runs rollouts on "num_threads" threads until "time_limit" has passed.
+  // Gets the moves of current player, the most visited first, each with the
+  // rate at which current player won the rollouts through it. Runs once.
   SearchResult Search(absl::Duration time_limit);
 
  private:
-  void SyncScoreNode(MctsNode* node);
+  MctsNode* NewNode(GoColor player);
+
+  // Publishes the scorer's result on "node", which is in STATE_SCORING and
+  // has the position "board", and creates its edges.
+  void ExpandNode(MctsNode* node, const GoBoard& board, bool success,
+                  const PolicyResult& candidate_moves,
+                  const ValueResult& score);
+
+  // Picks the move of "node" to go down with. "node" is scored, has edges
+  // and is reached by "parent_edge".
+  MctsEdge* SelectEdge(const MctsNode* node, const MctsEdge* parent_edge);
+
+  // Selects the path of a new rollout, and sends its last node to the
+  // scorer if the node is new. Otherwise backs up the rollout at once, and
+  // returns whether that counted a value, see BackUp.
+  bool StartRollout();
+
+  // Expands the node scored for a rollout, and backs up the rollout.
+  void FinishRollout(std::unique_ptr<PendingEvaluation> evaluation);
+
+  // Removes the virtual loss of a rollout from its path, and counts the
+  // value of "leaf", the node at its end, unless the node isn't scored: it
+  // is being scored for another rollout, or the scorer failed. Returns
+  // whether the value was counted.
+  bool BackUp(const std::vector<MctsEdge*>& path, const MctsNode* leaf);
+
+  void SearchThread(absl::Time deadline);
+
+  // Conditions on the queue, checked with queue_mutex_ held.
+  bool HasWork() const;
+  bool HasScoredOrDrained() const;
 
   const int num_threads_;
   AsyncScorer* scorer_ = nullptr;
 
+  // Owns every node and edge.
+  std::unique_ptr<MctsArena> arena_;
+  std::unique_ptr<GoBoard> root_board_;
+  // An edge that leads to the root, which holds the statistics of the root.
+  MctsEdge* root_edge_ = nullptr;
   MctsNode* root_ = nullptr;
-  // Rollouts start from these nodes, the grand children of the root.
-  std::vector<MctsNode*> rollout_points_;
+  std::atomic<int> num_nodes_{0};
 
   std::unique_ptr<MctsStats> search_stats_;
   std::vector<std::thread> search_threads_;
+
+  absl::Mutex queue_mutex_;
+  // Rollouts sent to the scorer and not finished yet.
+  int num_in_flight_ = 0;
+  // Rollouts whose node the scorer is done with.
+  std::deque<std::unique_ptr<PendingEvaluation>> scored_;
 };
 
 }  // namespace zebra_go
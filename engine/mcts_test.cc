@@ -1,5 +1,11 @@
 #include "engine/mcts.h"
 
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
 #include "engine/scorer.h"
 #include "glog/logging.h"
 #include "gtest/gtest.h"
@@ -7,13 +13,144 @@
 namespace zebra_go {
 namespace {
 
+// Answers the positions in batches, like TfScorer, every millisecond, with a
+// uniform policy and an even value. Records the largest batch.
+class BatchScorer : public AsyncScorer {
+ public:
+  BatchScorer() : thread_(&BatchScorer::Run, this) {}
+  ~BatchScorer() override {
+    {
+      absl::MutexLock lock(&mutex_);
+      done_ = true;
+    }
+    thread_.join();
+  }
+
+  void ScoreGoState(const GoBoard& board, Callback cb) override {
+    PolicyResult policy;
+    const std::vector<uint8_t> legal_moves = board.GetLegalMoves();
+    for (size_t i = 0; i < legal_moves.size(); ++i) {
+      if (legal_moves[i]) policy.emplace_back(board.Decode(i), 1);
+    }
+    absl::MutexLock lock(&mutex_);
+    batch_.emplace_back(std::move(policy), std::move(cb));
+  }
+
+  int max_batch_size() {
+    absl::MutexLock lock(&mutex_);
+    return max_batch_size_;
+  }
+
+ private:
+  void Run() {
+    while (true) {
+      std::vector<std::pair<PolicyResult, Callback>> batch;
+      {
+        absl::MutexLock lock(&mutex_);
+        if (done_) return;
+        batch.swap(batch_);
+        max_batch_size_ = std::max<int>(max_batch_size_, batch.size());
+      }
+      for (auto& request : batch) {
+        request.second(true, std::move(request.first),
+                       std::make_pair(false, 0.0f));
+      }
+      absl::SleepFor(absl::Milliseconds(1));
+    }
+  }
+
+  absl::Mutex mutex_;
+  std::vector<std::pair<PolicyResult, Callback>> batch_;
+  int max_batch_size_ = 0;
+  bool done_ = false;
+  std::thread thread_;
+};
+
 class MonteCarloSearchTreeTest : public ::testing::Test {
  protected:
   void SetUp() override {
+    scorer_.reset(new PlayoutScorer(/*num_playouts=*/4, /*komi=*/0.5));
   }
+
+  std::unique_ptr<AsyncScorer> scorer_;
 };
 
 TEST_F(MonteCarloSearchTreeTest, SimpleRun) {
+  std::unique_ptr<GoBoard> board(new GoBoard(5));
+  MonteCarloSearchTree tree(std::move(board), /*num_threads=*/4,
+                            scorer_.get());
+  auto result = tree.Search(absl::Milliseconds(300));
+  LOG(INFO) << result.DebugString();
+  ASSERT_FALSE(result.moves.empty());
+  EXPECT_GT(result.num_rollouts, 0);
+  // The root and at least its children.
+  EXPECT_GT(result.num_nodes, static_cast<int>(result.moves.size()));
+
+  // The threads share the rollouts, the most visited move first.
+  GoBoard empty(5);
+  for (const auto& move : result.moves) {
+    EXPECT_TRUE(empty.IsLegalMove(move.first)) << ToString(move.first);
+    EXPECT_GE(move.second, 0);
+    EXPECT_LE(move.second, 1);
+  }
+}
+
+TEST_F(MonteCarloSearchTreeTest, FindsCapture) {
+  // Three white stones B2-D2 in atari, with their last liberty on D3.
+  std::unique_ptr<GoBoard> board(new GoBoard(5));
+  const std::vector<GoPosition> black = {
+      {0, 1}, {4, 1}, {1, 0}, {2, 0}, {3, 0}, {1, 2}, {2, 2}};
+  const std::vector<GoPosition> white = {{1, 1}, {2, 1}, {3, 1}};
+  for (size_t i = 0; i < black.size(); ++i) {
+    ASSERT_TRUE(board->Move(black[i], nullptr));
+    ASSERT_TRUE(board->Move(i < white.size() ? white[i] : kMovePass,
+                            nullptr));
+  }
+  MonteCarloSearchTree tree(std::move(board), /*num_threads=*/4,
+                            scorer_.get());
+  auto result = tree.Search(absl::Milliseconds(500));
+  ASSERT_FALSE(result.moves.empty());
+  // The win rate depends on how many rollouts fit in the time limit, so
+  // only the move is checked.
+  EXPECT_EQ(GoPosition(3, 2), result.moves[0].first)
+      << result.DebugString();
+}
+
+TEST_F(MonteCarloSearchTreeTest, PassesOnSettledBoard) {
+  // Black holds A-C with two eyes on A, white holds D-E with two eyes on E.
+  // Every empty cell is an eye, so no move is searched.
+  std::unique_ptr<GoBoard> board(new GoBoard(5));
+  std::vector<GoPosition> black = {{0, 2}};
+  std::vector<GoPosition> white = {{4, 2}};
+  for (GoSizeT y = 0; y < 5; ++y) {
+    black.push_back({1, y});
+    black.push_back({2, y});
+    white.push_back({3, y});
+  }
+  for (size_t i = 0; i < black.size(); ++i) {
+    ASSERT_TRUE(board->Move(black[i], nullptr));
+    ASSERT_TRUE(board->Move(i < white.size() ? white[i] : kMovePass,
+                            nullptr));
+  }
+  MonteCarloSearchTree tree(std::move(board), /*num_threads=*/4,
+                            scorer_.get());
+  const absl::Time start = absl::Now();
+  auto result = tree.Search(absl::Seconds(30));
+  EXPECT_LT(absl::Now() - start, absl::Seconds(10));
+  ASSERT_EQ(1u, result.moves.size());
+  EXPECT_EQ(kMovePass, result.moves[0].first);
+  EXPECT_EQ(0, result.num_rollouts);
+}
+
+TEST_F(MonteCarloSearchTreeTest, BatchesEvaluations) {
+  // A single thread keeps many positions at the scorer at once.
+  BatchScorer scorer;
+  std::unique_ptr<GoBoard> board(new GoBoard(9));
+  MonteCarloSearchTree tree(std::move(board), /*num_threads=*/1, &scorer);
+  auto result = tree.Search(absl::Milliseconds(200));
+  ASSERT_FALSE(result.moves.empty());
+  EXPECT_GT(result.num_rollouts, 0);
+  EXPECT_GT(scorer.max_batch_size(), 1);
 }
 
 }  // namespace
@@ -0,0 +1,268 @@
+#include "engine/playout.h"
+
+#include <random>
+
+#include "absl/memory/memory.h"
+
+namespace zebra_go {
+
+namespace {
+
+// Cells around a cell in a pattern, see GoBoardT::pattern_offsets: the four
+// diagonals, then the four neighbors in the order of neighbor_offsets.
+constexpr int kDiagonalCells[4] = {0, 2, 5, 7};
+constexpr int kNeighborCells[4] = {1, 6, 3, 4};
+
+GoColor CellColor(uint16_t pattern, int cell) {
+  return static_cast<GoColor>((pattern >> (2 * cell)) & 3);
+}
+
+// The same rules as RunnerT::IsOwnEye and RunnerT::IsLoneSuicide, for the
+// player whose stones are COLOR_BLACK in the pattern.
+bool IsOwnEyeShape(uint16_t pattern) {
+  int opponent_diagonals = 0;
+  for (const int cell : kNeighborCells) {
+    const GoColor color = CellColor(pattern, cell);
+    if (color == COLOR_OFF_BOARD) {
+      opponent_diagonals = 1;
+    } else if (color != COLOR_BLACK) {
+      return false;
+    }
+  }
+  for (const int cell : kDiagonalCells) {
+    opponent_diagonals += (CellColor(pattern, cell) == COLOR_WHITE);
+  }
+  return opponent_diagonals < 2;
+}
+
+bool IsSurroundedShape(uint16_t pattern) {
+  for (const int cell : kNeighborCells) {
+    const GoColor color = CellColor(pattern, cell);
+    if (color != COLOR_WHITE && color != COLOR_OFF_BOARD) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+PatternWeights::PatternWeights() : shape_weights_(1 << 16) {
+  for (int pattern = 0; pattern < (1 << 16); ++pattern) {
+    const bool bad = IsOwnEyeShape(pattern) || IsSurroundedShape(pattern);
+    shape_weights_[pattern] = bad ? 0 : 1;
+  }
+}
+
+float PatternWeights::Weight(uint16_t pattern, uint8_t atari_flags,
+                             GoColor player) const {
+  const uint16_t relative = Relative(pattern, player);
+  bool save = false;
+  for (int i = 0; i < 4; ++i) {
+    if ((atari_flags >> i) & 1) {
+      if (CellColor(relative, kNeighborCells[i]) == COLOR_WHITE) {
+        return capture_weight;
+      }
+      save = true;
+    }
+  }
+  return shape_weights_[relative] * (save ? save_weight : 1);
+}
+
+class PlayoutEngine::Runner {
+ public:
+  virtual ~Runner() {}
+
+  // Plays one game, see PlayoutEngine::Run.
+  virtual int Run(int* num_moves) = 0;
+};
+
+namespace {
+
+template <int N>
+class RunnerT : public PlayoutEngine::Runner {
+ public:
+  typedef GoBoardT<N> Board;
+  typedef typename Board::Index Index;
+  typedef typename Board::CellSet CellSet;
+
+  RunnerT(const Board& start, uint64_t seed, const PatternWeights* weights)
+      : start_(start.Clone()), board_(start.Clone()), rng_(seed),
+        weights_(weights) {
+    if (weights_ != nullptr) {
+      start_->set_track_patterns(true);
+    }
+    start.GetPassAlive(settled_);
+    settled_cells_ = settled_[COLOR_BLACK];
+    settled_cells_ |= settled_[COLOR_WHITE];
+  }
+
+  int Run(int* num_moves) override {
+    Board& board = *board_;
+    board.CopyFrom(*start_);
+    // Superko is not checked, so a long cycle could go on forever.
+    const int max_moves = 3 * board.width() * board.height();
+    int consecutive_passes = 0;
+    int moves = 0;
+    CellSet captured;
+    while (consecutive_passes < 2 && moves < max_moves) {
+      const Index move = PickMove(board);
+      if (move == Board::kNoCell) {
+        board.Pass(nullptr);
+        ++consecutive_passes;
+      } else {
+        board.Play(move, &captured, nullptr);
+        consecutive_passes = 0;
+      }
+      ++moves;
+    }
+    *num_moves = moves;
+    return board.AreaScore(settled_);
+  }
+
+ private:
+  // Picks a random legal move that is worth playing, or kNoCell to pass.
+  Index PickMove(const Board& board) {
+    return weights_ != nullptr ? PickWeightedMove(board)
+                               : PickUniformMove(board);
+  }
+
+  Index PickUniformMove(const Board& board) {
+    CellSet candidates = board.LegalMoves();
+    candidates.AndNot(settled_cells_);
+    int count = candidates.Count();
+    while (count > 0) {
+      const Index idx = NthCell(candidates, rng_() % count);
+      if (!IsOwnEye(board, idx) && !IsLoneSuicide(board, idx)) return idx;
+      candidates.Reset(idx);
+      --count;
+    }
+    return Board::kNoCell;
+  }
+
+  Index PickWeightedMove(const Board& board) {
+    const GoColor player = board.current_player();
+    int num_candidates = 0;
+    float total = 0;
+    CellSet candidates = board.LegalMoves();
+    candidates.AndNot(settled_cells_);
+    candidates.ForEach([&](Index idx) {
+      const float weight = weights_->Weight(board.pattern(idx),
+                                            board.atari_flags(idx), player);
+      if (weight > 0) {
+        total += weight;
+        candidates_[num_candidates] = idx;
+        cumulative_weights_[num_candidates++] = total;
+      }
+    });
+    if (num_candidates == 0) return Board::kNoCell;
+    const float roll = std::uniform_real_distribution<float>(0, total)(rng_);
+    for (int i = 0; i < num_candidates - 1; ++i) {
+      if (roll < cumulative_weights_[i]) return candidates_[i];
+    }
+    return candidates_[num_candidates - 1];
+  }
+
+  // Returns the n-th smallest cell of the set, which has more than n cells.
+  static Index NthCell(const CellSet& cells, int n) {
+    for (int i = 0;; ++i) {
+      uint64_t word = cells.word(i);
+      const int count = __builtin_popcountll(word);
+      if (n >= count) {
+        n -= count;
+        continue;
+      }
+      for (; n > 0; --n) word &= word - 1;
+      return (i << 6) + __builtin_ctzll(word);
+    }
+  }
+
+  // An empty cell whose neighbors are all stones of current player, and that
+  // the opponent can't turn into a false eye: it holds at most one diagonal,
+  // or none on the edge of the board.
+  static bool IsOwnEye(const Board& board, Index idx) {
+    const GoColor player = board.current_player();
+    bool on_edge = false;
+    for (const Index offset : board.neighbor_offsets()) {
+      const GoColor color = board.StoneAt(idx + offset);
+      if (color == COLOR_OFF_BOARD) {
+        on_edge = true;
+      } else if (color != player) {
+        return false;
+      }
+    }
+    const GoColor opponent = GetOpponent(player);
+    int opponent_diagonals = on_edge ? 1 : 0;
+    for (const Index offset : {board.stride() - 1, board.stride() + 1}) {
+      opponent_diagonals += (board.StoneAt(idx + offset) == opponent);
+      opponent_diagonals += (board.StoneAt(idx - offset) == opponent);
+    }
+    return opponent_diagonals < 2;
+  }
+
+  // A stone surrounded by the opponent that captures nothing. GoBoardT allows
+  // it when no chain of current player is next to it, and it would leave a
+  // stone with no liberty.
+  static bool IsLoneSuicide(const Board& board, Index idx) {
+    const GoColor opponent = GetOpponent(board.current_player());
+    for (const Index offset : board.neighbor_offsets()) {
+      const Index n = idx + offset;
+      const GoColor color = board.StoneAt(n);
+      if (color == COLOR_OFF_BOARD) continue;
+      if (color != opponent || board.GetChain(n)->HasOneLiberty()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::unique_ptr<Board> start_;
+  std::unique_ptr<Board> board_;
+  std::mt19937_64 rng_;
+  const PatternWeights* weights_;
+  // Areas settled in the start position, see GoBoardT::GetPassAlive. No move
+  // is played there, so they stay settled until the end of every game.
+  CellSet settled_[3];
+  CellSet settled_cells_;
+  // Scratch space of PickWeightedMove.
+  Index candidates_[Board::kNumCells];
+  float cumulative_weights_[Board::kNumCells];
+};
+
+// Creates the runner that matches the GoBoardT<N> of a board.
+class RunnerFactory : public GoBoardCoreVisitor {
+ public:
+  RunnerFactory(uint64_t seed, const PatternWeights* weights)
+      : seed_(seed), weights_(weights) {}
+
+  void Visit(const GoBoardT<0>& board) override { Create(board); }
+  void Visit(const GoBoardT<9>& board) override { Create(board); }
+  void Visit(const GoBoardT<13>& board) override { Create(board); }
+  void Visit(const GoBoardT<19>& board) override { Create(board); }
+
+  std::unique_ptr<PlayoutEngine::Runner> runner;
+
+ private:
+  template <int N>
+  void Create(const GoBoardT<N>& board) {
+    runner = absl::make_unique<RunnerT<N>>(board, seed_, weights_);
+  }
+
+  const uint64_t seed_;
+  const PatternWeights* weights_;
+};
+
+}  // namespace
+
+PlayoutEngine::PlayoutEngine(const GoBoard& board, uint64_t seed,
+                             const PatternWeights* weights) {
+  RunnerFactory factory(seed, weights);
+  board.VisitCore(&factory);
+  runner_ = std::move(factory.runner);
+}
+
+PlayoutEngine::~PlayoutEngine() {}
+
+int PlayoutEngine::Run() {
+  return runner_->Run(&last_num_moves_);
+}
+
+}  // namespace zebra_go
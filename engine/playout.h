@@ -0,0 +1,88 @@
+#ifndef ZEBRA_GO_ENGINE_PLAYOUT_H_
+#define ZEBRA_GO_ENGINE_PLAYOUT_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "engine/go_game.h"
+
+namespace zebra_go {
+
+// Sampling weights of moves in pattern-guided playouts. A move is looked up by
+// its 3x3 pattern (see GoBoardT::pattern) as seen by the player to move, that
+// is with the player's stones as COLOR_BLACK and the opponent's as
+// COLOR_WHITE, together with the atari flags of its neighbors.
+class PatternWeights {
+ public:
+  // Weight 0 for filling an own eye or playing a lone suicide stone, 1 for
+  // any other shape. Capturing and saving a chain from atari are weighted up.
+  PatternWeights();
+
+  // Turns a pattern into the view of "player".
+  static uint16_t Relative(uint16_t pattern, GoColor player) {
+    if (player == COLOR_BLACK) return pattern;
+    // Swaps the colors 1 and 2, the only ones whose two bits differ.
+    const uint16_t differ = (pattern ^ (pattern >> 1)) & 0x5555;
+    return pattern ^ (differ | (differ << 1));
+  }
+
+  float shape_weight(uint16_t relative_pattern) const {
+    return shape_weights_[relative_pattern];
+  }
+  void set_shape_weight(uint16_t relative_pattern, float weight) {
+    shape_weights_[relative_pattern] = weight;
+  }
+
+  // Replaces the shape weight of a move next to an opponent chain in atari.
+  float capture_weight = 20;
+  // Multiplies the shape weight of a move next to an own chain in atari.
+  float save_weight = 5;
+
+  // Weight of a move of "player" on an empty cell with the given pattern and
+  // atari flags. 0 if the move should not be played.
+  float Weight(uint16_t pattern, uint8_t atari_flags, GoColor player) const;
+
+ private:
+  std::vector<float> shape_weights_;
+};
+
+// Light playouts: from a given position, both players play random legal
+// moves until both pass in a row, then the game is scored by area. A player
+// never fills one of its own eyes, nor plays a lone stone that has no liberty
+// and captures nothing, nor plays in an area that is settled in the start
+// position, and passes when no other move is left. Settled areas score for
+// their owner, dead stones included. Moves are drawn uniformly, or in
+// proportion to PatternWeights if given, in which case the board keeps the
+// 3x3 patterns up to date as it goes.
+//
+// Playouts run on a copy of the bare rules core (GoBoardT<N>), so they skip
+// feature planes, territory estimation, positional superko and undo. Each
+// one starts with a memcpy of the start position.
+//
+// Not thread-safe; use one PlayoutEngine per thread.
+class PlayoutEngine {
+ public:
+  // Copies the position of "board". Every Run starts from it. "weights" is
+  // nullable and must outlive the engine.
+  PlayoutEngine(const GoBoard& board, uint64_t seed,
+                const PatternWeights* weights = nullptr);
+  ~PlayoutEngine();
+
+  // Plays one game to the end. Returns the area score, black minus white,
+  // without komi.
+  int Run();
+
+  // Number of moves, passes included, of the last Run.
+  int last_num_moves() const { return last_num_moves_; }
+
+  class Runner;
+
+ private:
+  std::unique_ptr<Runner> runner_;
+  int last_num_moves_ = 0;
+};
+
+}  // namespace zebra_go
+
+#endif  // ZEBRA_GO_ENGINE_PLAYOUT_H_
@@ -0,0 +1,121 @@
+#include "engine/playout.h"
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace zebra_go {
+namespace {
+
+TEST(PlayoutTest, GamesEndAndAreScored) {
+  for (const GoSizeT size : {7, 9, 19}) {
+    GoBoard board(size);
+    PlayoutEngine playout(board, /*seed=*/size);
+    for (int i = 0; i < 20; ++i) {
+      const int score = playout.Run();
+      EXPECT_LE(-size * size, score);
+      EXPECT_GE(size * size, score);
+      EXPECT_GT(playout.last_num_moves(), size * size / 2);
+      EXPECT_LT(playout.last_num_moves(), 3 * size * size);
+    }
+  }
+}
+
+TEST(PlayoutTest, SameSeedSameGames) {
+  GoBoard board(9);
+  ASSERT_TRUE(board.Move({4, 4}, nullptr));
+  PlayoutEngine a(board, 42), b(board, 42);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(a.Run(), b.Run());
+    EXPECT_EQ(a.last_num_moves(), b.last_num_moves());
+  }
+}
+
+TEST(PlayoutTest, EyesAreNotFilled) {
+  // Black owns the whole board with two eyes, at A1 and E5. White can't play
+  // in them and black doesn't fill them, so every game is two passes.
+  GoBoard board(5);
+  for (GoSizeT y = 0; y < 5; ++y) {
+    for (GoSizeT x = 0; x < 5; ++x) {
+      if ((x == 0 && y == 0) || (x == 4 && y == 4)) continue;
+      ASSERT_TRUE(board.Move({x, y}, nullptr));
+      ASSERT_TRUE(board.Move(kMovePass, nullptr));
+    }
+  }
+  PlayoutEngine playout(board, 1);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(25, playout.Run());
+    EXPECT_EQ(2, playout.last_num_moves());
+  }
+}
+
+TEST(PlayoutTest, SettledAreasAreSkipped) {
+  // As above, but with a dead white stone on A1. Black could capture it on
+  // A2, yet the eye is settled, so both players pass at once and A1 scores
+  // for black.
+  GoBoard board(5);
+  ASSERT_TRUE(board.Move(kMovePass, nullptr));
+  ASSERT_TRUE(board.Move({0, 0}, nullptr));
+  for (GoSizeT y = 0; y < 5; ++y) {
+    for (GoSizeT x = 0; x < 5; ++x) {
+      if ((x == 0 && y <= 1) || (x == 4 && y == 4)) continue;
+      ASSERT_TRUE(board.Move({x, y}, nullptr));
+      ASSERT_TRUE(board.Move(kMovePass, nullptr));
+    }
+  }
+  PatternWeights weights;
+  PlayoutEngine uniform(board, 1), guided(board, 1, &weights);
+  for (PlayoutEngine* playout : {&uniform, &guided}) {
+    EXPECT_EQ(25, playout->Run());
+    EXPECT_EQ(2, playout->last_num_moves());
+  }
+}
+
+TEST(PlayoutTest, PatternWeights) {
+  const PatternWeights weights;
+  // Black stones on all the neighbors and no diagonal: an eye for black.
+  const uint16_t eye = 0x0000 | (1 << 2) | (1 << 6) | (1 << 8) | (1 << 12);
+  EXPECT_EQ(0, weights.Weight(eye, 0, COLOR_BLACK));
+  // For white it is a lone suicide, unless one of the stones is in atari.
+  EXPECT_EQ(0, weights.Weight(eye, 0, COLOR_WHITE));
+  EXPECT_EQ(weights.capture_weight, weights.Weight(eye, 0x2, COLOR_WHITE));
+  EXPECT_EQ(eye << 1, PatternWeights::Relative(eye, COLOR_WHITE));
+  // An empty neighborhood, next to an own chain in atari or not.
+  EXPECT_EQ(1, weights.Weight(0, 0, COLOR_WHITE));
+  const uint16_t next_to_black = 1 << 2;
+  EXPECT_EQ(weights.save_weight,
+            weights.Weight(next_to_black, 0x1, COLOR_BLACK));
+}
+
+TEST(PlayoutTest, PatternGuidedGames) {
+  const PatternWeights weights;
+  GoBoard board(9);
+  ASSERT_TRUE(board.Move({4, 4}, nullptr));
+  PlayoutEngine a(board, 7, &weights), b(board, 7, &weights);
+  for (int i = 0; i < 20; ++i) {
+    const int score = a.Run();
+    EXPECT_EQ(score, b.Run());
+    EXPECT_EQ(a.last_num_moves(), b.last_num_moves());
+    EXPECT_LE(-81, score);
+    EXPECT_GE(81, score);
+    EXPECT_GT(a.last_num_moves(), 40);
+    EXPECT_LT(a.last_num_moves(), 3 * 81);
+  }
+}
+
+TEST(PlayoutTest, PatternGuidedEyesAreNotFilled) {
+  GoBoard board(5);
+  for (GoSizeT y = 0; y < 5; ++y) {
+    for (GoSizeT x = 0; x < 5; ++x) {
+      if ((x == 0 && y == 0) || (x == 4 && y == 4)) continue;
+      ASSERT_TRUE(board.Move({x, y}, nullptr));
+      ASSERT_TRUE(board.Move(kMovePass, nullptr));
+    }
+  }
+  const PatternWeights weights;
+  PlayoutEngine playout(board, 1, &weights);
+  EXPECT_EQ(25, playout.Run());
+  EXPECT_EQ(2, playout.last_num_moves());
+}
+
+}  // namespace
+}  // namespace zebra_go
@@ -6,6 +6,7 @@
 #include "absl/synchronization/notification.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
+#include "engine/playout.h"
 #include "engine/utils.h"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
@@ -58,7 +59,9 @@ ValueResult SimpleEvaluate(const GoBoard& board) {
   return std::make_pair(should_resign, score);
 }
 
+// "legal_moves" is GoBoard::GetLegalMoves() of the board.
 void ConvertToPolicyResult(const GoBoard& board,
+                           const std::vector<uint8_t>& legal_moves,
                            const std::vector<float>&  policy_output,
                            PolicyResult* policy_result) {
   struct CompareSecond {
@@ -71,9 +74,8 @@ void ConvertToPolicyResult(const GoBoard& board,
   // Selects top 20 legal positions with highest scores.
   TopK<std::pair<GoPosition, float>, CompareSecond> top_k(kMaxPolicyResults);
   for (size_t i = 0; i < policy_output.size(); ++i) {
-    GoPosition pos = board.Decode(i);
-    if (board.IsLegalMove(pos)) {
-      top_k.Insert(std::make_pair(pos, policy_output[i]));
+    if (legal_moves[i]) {
+      top_k.Insert(std::make_pair(board.Decode(i), policy_output[i]));
     }
   }
 
@@ -89,6 +91,20 @@ void ConvertToPolicyResult(const GoBoard& board,
   }
 }
 
+// Gives every legal move the same score. Leaves "policy_result" empty if no
+// move is legal, and the search then passes.
+void UniformPolicy(const GoBoard& board, PolicyResult* policy_result) {
+  const std::vector<uint8_t>& legal_moves = board.GetLegalMoves();
+  for (GoSizeT i = 0; i < board.width(); ++i) {
+    for (GoSizeT j = 0; j < board.height(); ++j) {
+      if (legal_moves[board.Encode({i, j})]) {
+        policy_result->emplace_back(std::make_pair(std::make_pair(i, j), 1.0));
+      }
+    }
+  }
+  Normalize(policy_result);
+}
+
 ValueResult CombineValueResult(float value_output,
                                const ValueResult& fast_eval) {
   if (fast_eval.first) {
@@ -159,15 +175,7 @@ bool AsyncScorer::SyncScoreGoState(const GoBoard& board,
 
 void SimpleScorer::ScoreGoState(const GoBoard& board, Callback cb) {
   PolicyResult* policy_result = new PolicyResult();
-  for (GoSizeT i = 0; i < board.width(); ++i) {
-    for (GoSizeT j = 0; j < board.height(); ++j) {
-      // So if there is no legal move, x and y will remain COORD_PASS.
-      if (board.IsLegalMove({i, j})) {
-        policy_result->emplace_back(std::make_pair(std::make_pair(i, j), 1.0));
-      }
-    }
-  }
-  Normalize(policy_result);
+  UniformPolicy(board, policy_result);
   auto value_result = SimpleEvaluate(board);
 
   GetScorerThreadPool()->Schedule(
@@ -177,6 +185,32 @@ void SimpleScorer::ScoreGoState(const GoBoard& board, Callback cb) {
       });
 }
 
+void PlayoutScorer::ScoreGoState(const GoBoard& board, Callback cb) {
+  PolicyResult* policy_result = new PolicyResult();
+  UniformPolicy(board, policy_result);
+  const ValueResult fast_eval = SimpleEvaluate(board);
+  const GoColor player = board.current_player();
+  const int num_playouts = num_playouts_;
+  const float komi = komi_;
+  // The engine copies the position, so the board is not used after return.
+  PlayoutEngine* playout = new PlayoutEngine(board, next_seed_++);
+
+  GetScorerThreadPool()->Schedule(
+      [cb, policy_result, fast_eval, player, num_playouts, komi, playout]() {
+        int wins = 0;
+        for (int i = 0; i < num_playouts; ++i) {
+          const float black_lead = playout->Run() - komi;
+          wins += ((black_lead > 0) == (player == COLOR_BLACK));
+        }
+        // In [-1, 1], positive if current player wins more often.
+        const float value = (2.0f * wins - num_playouts) / num_playouts;
+        cb(true, std::move(*policy_result),
+           CombineValueResult(value, fast_eval));
+        delete policy_result;
+        delete playout;
+      });
+}
+
 std::unique_ptr<TfScorer> TfScorer::CreateFromFlags() {
   // Create TensorFlow client:
   auto tf_client = TensorFlowClient::Create(
@@ -189,7 +223,9 @@ std::unique_ptr<TfScorer> TfScorer::CreateFromFlags() {
 
 void TfScorer::ScoreGoState(const GoBoard& board, Callback cb) {
   ValueResult fast_eval = SimpleEvaluate(board);
-  auto callback = [&board, fast_eval, cb](
+  // Taken here, as GetLegalMoves must not race with the caller.
+  std::vector<uint8_t> legal_moves = board.GetLegalMoves();
+  auto callback = [&board, legal_moves, fast_eval, cb](
       const tf::Status& status, std::vector<std::vector<float>> outputs) {
     PolicyResult policy_result;
     if (status.ok()) {
@@ -197,7 +233,7 @@ void TfScorer::ScoreGoState(const GoBoard& board, Callback cb) {
 
       auto& policy_output = outputs[0];
       CHECK_EQ(board.width() * board.height(), policy_output.size());
-      ConvertToPolicyResult(board, policy_output, &policy_result);
+      ConvertToPolicyResult(board, legal_moves, policy_output, &policy_result);
 
       const auto& value_output = outputs[1];
       CHECK_EQ(1, value_output.size());
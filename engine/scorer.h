@@ -1,6 +1,7 @@
 #ifndef ZEBRA_GO_ENGINE_SCORER_H_
 #define ZEBRA_GO_ENGINE_SCORER_H_
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <utility>
@@ -43,6 +44,11 @@ class AsyncScorer {
   // Synchronous version of ScoreGoState.
   bool SyncScoreGoState(const GoBoard& board,
                         PolicyResult* policy, ValueResult* value);
+
+  // Sets the points added to white's area in the games the scorer plays to
+  // the end, if any; other scorers ignore it. Must not be called while a
+  // position is being scored.
+  virtual void SetKomi(float komi) {}
 };
 
 // A trivial implementation of AsyncScorer, mainly for testing.
@@ -54,6 +60,28 @@ class SimpleScorer : public AsyncScorer {
   void ScoreGoState(const GoBoard& board, Callback cb) override;
 };
 
+// An implementation of AsyncScorer that needs no model. The policy is uniform
+// over the legal moves, like SimpleScorer, and the value is how often current
+// player wins light playouts (see PlayoutEngine) from the position, mapped
+// to [-1, 1].
+class PlayoutScorer : public AsyncScorer {
+ public:
+  PlayoutScorer(int num_playouts, float komi)
+      : num_playouts_(num_playouts), komi_(komi) {
+    CHECK_GT(num_playouts, 0);
+  }
+  ~PlayoutScorer() override {}
+
+  void ScoreGoState(const GoBoard& board, Callback cb) override;
+  void SetKomi(float komi) override { komi_ = komi; }
+
+ private:
+  const int num_playouts_;
+  // Points added to white's area.
+  float komi_;
+  std::atomic<uint64_t> next_seed_{1};
+};
+
 // An implementation of AsyncScorer based on a trained model.
 class TfScorer : public AsyncScorer {
  public:
@@ -12,5 +12,31 @@ TEST(SamplePolicyTest, Sample) {
   EXPECT_TRUE(pos == GoPosition({1,1}) || pos == GoPosition({2,2}));
 }
 
+TEST(PlayoutScorerTest, Value) {
+  // Black owns the whole board with two eyes, at A1 and E5.
+  GoBoard board(5);
+  for (GoSizeT y = 0; y < 5; ++y) {
+    for (GoSizeT x = 0; x < 5; ++x) {
+      if ((x == 0 && y == 0) || (x == 4 && y == 4)) continue;
+      ASSERT_TRUE(board.Move({x, y}, nullptr));
+      ASSERT_TRUE(board.Move(kMovePass, nullptr));
+    }
+  }
+  PlayoutScorer scorer(/*num_playouts=*/10, /*komi=*/7.5);
+  PolicyResult policy;
+  ValueResult value;
+  ASSERT_TRUE(scorer.SyncScoreGoState(board, &policy, &value));
+  EXPECT_FLOAT_EQ(1, value.second);
+
+  ASSERT_TRUE(board.Move(kMovePass, nullptr));
+  ASSERT_TRUE(scorer.SyncScoreGoState(board, &policy, &value));
+  EXPECT_FLOAT_EQ(-1, value.second);
+
+  // With more komi than the board has points, white wins instead.
+  scorer.SetKomi(30.5);
+  ASSERT_TRUE(scorer.SyncScoreGoState(board, &policy, &value));
+  EXPECT_FLOAT_EQ(1, value.second);
+}
+
 }  // namespace
 }  // namespace zebra_go
@@ -43,7 +43,8 @@ bool PresetStones(GoColor c, const std::vector<sgf_parser::GoPos>& stones,
 bool ReplayGame(const std::string& sgf,
                 std::function<bool(const ReplayContext&)> begin_cb,
                 std::function<void(const ReplayContext&)> callback,
-                std::function<void(std::unique_ptr<GoBoard>)> end_callback) {
+                std::function<void(std::unique_ptr<GoBoard>)> end_callback,
+                bool with_features) {
   // Parse the SGF.
   GameRecord game;
   std::string errors;
@@ -60,6 +61,9 @@ bool ReplayGame(const std::string& sgf,
 
   std::unique_ptr<GoBoard> board(
       new GoBoard(game.board_width, game.board_height));
+  if (!with_features) {
+    board->DisableFeatures();
+  }
   ReplayContext context;
   context.board = board.get();
   context.num_steps = 0;
@@ -27,6 +27,8 @@ std::unique_ptr<GoBoard> SgfToGoBoard(const std::string& sgf);
 // in "begin_cb". Then it runs "callback" at each step during the replay and
 // runs "end_callback" when reaching the end of the game. Returns false on any
 // error. In case of an error, "callback" or "end_callback" may not be called.
+// If "with_features" is false, the board has its feature planes disabled (see
+// GoBoard::DisableFeatures), so the callbacks must not call GetFeatures.
 struct ReplayContext {
   const GoBoard* board = nullptr;
   int num_steps        = 0;
@@ -36,7 +38,8 @@ struct ReplayContext {
 bool ReplayGame(const std::string& sgf,
                 std::function<bool(const ReplayContext&)> begin_cb,
                 std::function<void(const ReplayContext&)> callback,
-                std::function<void(std::unique_ptr<GoBoard>)> end_callback);
+                std::function<void(std::unique_ptr<GoBoard>)> end_callback,
+                bool with_features = true);
 
 // Reads the file content to a string.
 std::string ReadFileToString(const std::string& filename);
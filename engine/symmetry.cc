@@ -0,0 +1,88 @@
+#include "engine/symmetry.h"
+
+#include <algorithm>
+
+namespace zebra_go {
+
+namespace {
+
+// Gather tables of all the board sizes, built on first use. Each size takes
+// kNumSymmetries * size * size entries.
+class DynamicSymmetryTables {
+ public:
+  DynamicSymmetryTables() : tables_(kMaxBoardSize + 1) {
+    for (GoSizeT size = 1; size <= kMaxBoardSize; ++size) {
+      auto& tables = tables_[size];
+      tables.resize(kNumSymmetries * size * size);
+      for (int s = 0; s < kNumSymmetries; ++s) {
+        const Symmetry inverse = InverseSymmetry(static_cast<Symmetry>(s));
+        for (int i = 0; i < size * size; ++i) {
+          const GoPosition from = ApplySymmetry(
+              inverse, size, GoPosition(i % size, i / size));
+          tables[s * size * size + i] = from.second * size + from.first;
+        }
+      }
+    }
+  }
+
+  const int16_t* Get(Symmetry s, GoSizeT size) const {
+    return tables_[size].data() + s * size * size;
+  }
+
+ private:
+  std::vector<std::vector<int16_t>> tables_;
+};
+
+}  // namespace
+
+const int16_t* GetSymmetryTable(Symmetry s, GoSizeT size) {
+  DCHECK(s >= 0 && s < kNumSymmetries);
+  CHECK(size > 0 && size <= kMaxBoardSize);
+  switch (size) {
+    case 9:  return kSymmetryTables<9>.table[s];
+    case 13: return kSymmetryTables<13>.table[s];
+    case 19: return kSymmetryTables<19>.table[s];
+  }
+  static const DynamicSymmetryTables* tables = new DynamicSymmetryTables;
+  return tables->Get(s, size);
+}
+
+void ApplySymmetry(Symmetry s, GoSizeT size, const std::vector<float>& policy,
+                   std::vector<float>* output) {
+  const int num_points = size * size;
+  CHECK_GE(policy.size(), num_points);
+  output->resize(policy.size());
+  ApplySymmetry(s, size, policy.data(), output->data());
+  std::copy(policy.begin() + num_points, policy.end(),
+            output->begin() + num_points);
+}
+
+void ApplySymmetry(Symmetry s, const GoFeatureSet& features,
+                   GoFeatureSet* output) {
+  CHECK_EQ(features.width(), features.height());
+  CHECK_EQ(features.width(), output->width());
+  CHECK_EQ(features.height(), output->height());
+  CHECK_EQ(features.num_planes(), output->num_planes());
+  const GoSizeT size = features.width();
+  const int16_t* table = GetSymmetryTable(s, size);
+  // All the planes of a cell are packed in one byte, so one pass moves them.
+  const uint8_t* in = features.cells();
+  uint8_t* out = output->mutable_cells();
+  for (int i = 0; i < size * size; ++i) out[i] = in[table[i]];
+  if (features.has_tactical_planes()) {
+    const uint8_t* tactical_in = features.tactical_cells();
+    uint8_t* tactical_out = output->mutable_tactical_cells();
+    for (int i = 0; i < size * size; ++i) {
+      tactical_out[i] = tactical_in[table[i]];
+    }
+  }
+  if (features.num_history() > 0) {
+    const uint8_t* history_in = features.history_cells();
+    uint8_t* history_out = output->mutable_history_cells();
+    for (int i = 0; i < size * size; ++i) {
+      history_out[i] = history_in[table[i]];
+    }
+  }
+}
+
+}  // namespace zebra_go
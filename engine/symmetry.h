@@ -0,0 +1,103 @@
+#ifndef ZEBRA_GO_ENGINE_SYMMETRY_H_
+#define ZEBRA_GO_ENGINE_SYMMETRY_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "engine/go_game.h"
+
+namespace zebra_go {
+
+// The 8 symmetries of a square board (the dihedral group of order 8). A
+// symmetry is a combination of a transposition (swap x and y), done first,
+// then a flip of x (x -> size-1-x) and a flip of y. The value of a Symmetry
+// is made of these three bits.
+enum Symmetry {
+  SYMMETRY_IDENTITY       = 0,
+  SYMMETRY_FLIP_X         = 1,
+  SYMMETRY_FLIP_Y         = 2,
+  SYMMETRY_ROTATE_180     = 3,  // Flip x and y.
+  SYMMETRY_TRANSPOSE      = 4,
+  SYMMETRY_ROTATE_90      = 5,  // Transpose, then flip x.
+  SYMMETRY_ROTATE_270     = 6,  // Transpose, then flip y.
+  SYMMETRY_ANTI_TRANSPOSE = 7,
+};
+
+constexpr int kNumSymmetries = 8;
+
+// The symmetry that undoes "s". Flips are their own inverses; after a
+// transposition, the x and y flips trade places.
+constexpr Symmetry InverseSymmetry(Symmetry s) {
+  return (s & SYMMETRY_TRANSPOSE)
+             ? static_cast<Symmetry>(SYMMETRY_TRANSPOSE | ((s & 1) << 1) |
+                                     ((s >> 1) & 1))
+             : s;
+}
+
+// Maps a position on a size*size board. Pass, resign and kNPos are kept.
+constexpr GoPosition ApplySymmetry(Symmetry s, GoSizeT size, GoPosition pos) {
+  if (pos.first < 0) return pos;
+  GoSizeT x = pos.first, y = pos.second;
+  if (s & SYMMETRY_TRANSPOSE) {
+    const GoSizeT t = x;
+    x = y;
+    y = t;
+  }
+  if (s & SYMMETRY_FLIP_X) x = size - 1 - x;
+  if (s & SYMMETRY_FLIP_Y) y = size - 1 - y;
+  return GoPosition(x, y);
+}
+
+// Gather tables for a size*size board, indexed like GoBoard::Encode. The
+// transformed image of a plane "in" under symmetry s is
+//   out[i] = in[table[s][i]]  for i in [0, size*size),
+// so each transform is a single pass over the output.
+template <int N>
+struct SymmetryTables {
+  int16_t table[kNumSymmetries][N * N];
+};
+
+template <int N>
+constexpr SymmetryTables<N> MakeSymmetryTables() {
+  SymmetryTables<N> tables{};
+  for (int s = 0; s < kNumSymmetries; ++s) {
+    const Symmetry inverse = InverseSymmetry(static_cast<Symmetry>(s));
+    for (int i = 0; i < N * N; ++i) {
+      const GoPosition from = ApplySymmetry(
+          inverse, N, GoPosition(i % N, i / N));
+      tables.table[s][i] = from.second * N + from.first;
+    }
+  }
+  return tables;
+}
+
+// Built at compile time for the board sizes GoBoard specializes.
+template <int N>
+constexpr SymmetryTables<N> kSymmetryTables = MakeSymmetryTables<N>();
+
+// Returns the gather table of symmetry s for a size*size board, with
+// size*size entries. Tables for 9, 13 and 19 are the constants above; the
+// other sizes are built once, on first use.
+const int16_t* GetSymmetryTable(Symmetry s, GoSizeT size);
+
+// Transforms a plane of size*size values. "out" must not alias "in".
+inline void ApplySymmetry(Symmetry s, GoSizeT size, const float* in,
+                          float* out) {
+  const int16_t* table = GetSymmetryTable(s, size);
+  for (int i = 0; i < size * size; ++i) out[i] = in[table[i]];
+}
+
+// Transforms a policy vector. Values past size*size, e.g. a pass score, are
+// copied unchanged. To map the policy that the model produced for features
+// transformed by s back to the real board, use InverseSymmetry(s).
+void ApplySymmetry(Symmetry s, GoSizeT size, const std::vector<float>& policy,
+                   std::vector<float>* output);
+
+// Transforms all the planes of a square feature set. "output" must have the
+// same size as "features".
+void ApplySymmetry(Symmetry s, const GoFeatureSet& features,
+                   GoFeatureSet* output);
+
+}  // namespace zebra_go
+
+#endif  // ZEBRA_GO_ENGINE_SYMMETRY_H_
@@ -0,0 +1,93 @@
+#include "engine/symmetry.h"
+
+#include <random>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace zebra_go {
+namespace {
+
+constexpr Symmetry kAllSymmetries[] = {
+  SYMMETRY_IDENTITY, SYMMETRY_FLIP_X, SYMMETRY_FLIP_Y, SYMMETRY_ROTATE_180,
+  SYMMETRY_TRANSPOSE, SYMMETRY_ROTATE_90, SYMMETRY_ROTATE_270,
+  SYMMETRY_ANTI_TRANSPOSE,
+};
+
+TEST(SymmetryTest, Positions) {
+  // 90 degrees counterclockwise, with A1 at the lower left.
+  EXPECT_EQ(GoPosition(18, 0), ApplySymmetry(SYMMETRY_ROTATE_90, 19, {0, 0}));
+  EXPECT_EQ(GoPosition(16, 3), ApplySymmetry(SYMMETRY_ROTATE_90, 19, {3, 2}));
+  EXPECT_EQ(GoPosition(2, 15), ApplySymmetry(SYMMETRY_ROTATE_270, 19, {3, 2}));
+  EXPECT_EQ(GoPosition(15, 16),
+            ApplySymmetry(SYMMETRY_ROTATE_180, 19, {3, 2}));
+  EXPECT_EQ(kMovePass, ApplySymmetry(SYMMETRY_ROTATE_90, 19, kMovePass));
+
+  for (const Symmetry s : kAllSymmetries) {
+    const Symmetry inverse = InverseSymmetry(s);
+    for (GoSizeT x = 0; x < 7; ++x) {
+      for (GoSizeT y = 0; y < 7; ++y) {
+        const GoPosition moved = ApplySymmetry(s, 7, {x, y});
+        EXPECT_EQ(GoPosition(x, y), ApplySymmetry(inverse, 7, moved));
+      }
+    }
+  }
+}
+
+TEST(SymmetryTest, Tables) {
+  static_assert(kSymmetryTables<9>.table[SYMMETRY_FLIP_X][0] == 8,
+                "Tables are built at compile time.");
+  for (const GoSizeT size : {1, 5, 9, 13, 19}) {
+    std::vector<float> plane(size * size);
+    for (int i = 0; i < size * size; ++i) plane[i] = i;
+    for (const Symmetry s : kAllSymmetries) {
+      std::vector<float> moved, restored;
+      ApplySymmetry(s, size, plane, &moved);
+      for (int i = 0; i < size * size; ++i) {
+        const GoPosition pos =
+            ApplySymmetry(s, size, GoPosition(i % size, i / size));
+        EXPECT_EQ(i, moved[pos.second * size + pos.first]);
+      }
+      ApplySymmetry(InverseSymmetry(s), size, moved, &restored);
+      EXPECT_EQ(plane, restored);
+    }
+  }
+}
+
+TEST(SymmetryTest, PolicyWithPass) {
+  std::vector<float> policy = {0, 1, 2, 3, 0.5};
+  std::vector<float> output;
+  ApplySymmetry(SYMMETRY_TRANSPOSE, 2, policy, &output);
+  EXPECT_EQ(std::vector<float>({0, 2, 1, 3, 0.5}), output);
+}
+
+// Playing the transformed moves gives the transformed features.
+TEST(SymmetryTest, FeatureSet) {
+  const GoSizeT kSize = 9;
+  std::mt19937 rng(2018);
+  for (const Symmetry s : kAllSymmetries) {
+    GoBoard board(kSize), moved_board(kSize);
+    board.EnableTacticalFeatures(10000);
+    moved_board.EnableTacticalFeatures(10000);
+    board.EnableHistoryFeatures(2);
+    moved_board.EnableHistoryFeatures(2);
+    for (int i = 0; i < 60; ++i) {
+      const GoPosition move(rng() % kSize, rng() % kSize);
+      if (!board.IsLegalMove(move)) continue;
+      ASSERT_TRUE(board.Move(move, nullptr));
+      ASSERT_TRUE(moved_board.Move(ApplySymmetry(s, kSize, move), nullptr));
+    }
+
+    GoFeatureSet output(kSize, kSize, /*tactical_planes=*/true,
+                        /*num_history=*/2);
+    ApplySymmetry(s, board.GetFeatures(), &output);
+    const GoFeatureSet& expected = moved_board.GetFeatures();
+    for (int pid = 0; pid < expected.num_planes(); ++pid) {
+      EXPECT_EQ(expected.plane(pid), output.plane(pid))
+          << expected.GetPlaneName(pid);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace zebra_go
@@ -0,0 +1,165 @@
+#include "engine/tactics.h"
+
+namespace zebra_go {
+
+template <int N>
+void TacticalReaderT<N>::Start(const Board& board, int max_nodes) {
+  CHECK_GT(max_nodes, 0);
+  if (scratch_ == nullptr) {
+    scratch_ = board.Clone();
+  } else {
+    scratch_->CopyFrom(board);
+  }
+  // The scratch board only needs the rules.
+  scratch_->set_track_dirty(false);
+  scratch_->set_track_patterns(false);
+  depth_ = 0;
+  nodes_left_ = max_nodes;
+  num_nodes_ = 0;
+  out_of_nodes_ = false;
+}
+
+template <int N>
+bool TacticalReaderT<N>::Play(Index idx) {
+  if (nodes_left_ == 0) {
+    out_of_nodes_ = true;
+    return false;
+  }
+  --nodes_left_;
+  ++num_nodes_;
+  if (depth_ == static_cast<int>(undo_stack_.size())) {
+    undo_stack_.emplace_back();
+  }
+  scratch_->Play(idx, &captured_, &undo_stack_[depth_++]);
+  return true;
+}
+
+template <int N>
+void TacticalReaderT<N>::Undo() {
+  DCHECK_GT(depth_, 0);
+  scratch_->Undo(undo_stack_[--depth_]);
+}
+
+template <int N>
+typename TacticalReaderT<N>::CellSet TacticalReaderT<N>::EscapeMoves(
+    Index target) const {
+  const typename Board::Chain* chain = scratch_->GetChain(target);
+  CellSet moves = chain->liberties;
+  const GoColor color = chain->color;
+  const auto offsets = scratch_->neighbor_offsets();
+  chain->stones.ForEach([this, color, &offsets, &moves](Index stone) {
+    for (const Index offset : offsets) {
+      const typename Board::Chain* other = scratch_->GetChain(stone + offset);
+      if (other != nullptr && other->color != color &&
+          other->HasOneLiberty()) {
+        moves.Set(other->FirstLiberty());
+      }
+    }
+  });
+  return moves;
+}
+
+template <int N>
+bool TacticalReaderT<N>::CanCapture(Index target) {
+  CellSet liberties = scratch_->GetChain(target)->liberties;
+  while (!liberties.Empty()) {
+    const Index move = liberties.First();
+    liberties.Reset(move);
+    if (CapturesWith(target, move)) return true;
+  }
+  return false;
+}
+
+template <int N>
+bool TacticalReaderT<N>::CanEscape(Index target) {
+  CellSet moves = EscapeMoves(target);
+  while (!moves.Empty()) {
+    const Index move = moves.First();
+    moves.Reset(move);
+    if (EscapesWith(target, move)) return true;
+  }
+  return false;
+}
+
+template <int N>
+bool TacticalReaderT<N>::CapturesWith(Index target, Index move) {
+  if (!scratch_->IsLegalMove(move)) return false;
+  if (scratch_->GetChain(target)->HasOneLiberty()) return true;
+  if (!Play(move)) return false;
+  // GoBoardT lets a lone stone be played with no liberty, which is no atari
+  // at all.
+  const bool captured = !scratch_->GetChain(move)->liberties.Empty() &&
+                        scratch_->GetChain(target)->HasOneLiberty() &&
+                        !CanEscape(target);
+  Undo();
+  return captured;
+}
+
+template <int N>
+bool TacticalReaderT<N>::EscapesWith(Index target, Index move) {
+  if (!scratch_->IsLegalMove(move)) return false;
+  if (!Play(move)) return false;
+  const int num_liberties = scratch_->GetChain(target)->liberties.Count();
+  const bool escaped =
+      num_liberties >= 3 || (num_liberties == 2 && !CanCapture(target));
+  Undo();
+  return escaped;
+}
+
+template <int N>
+void TacticalReaderT<N>::Read(const Board& board, int max_nodes,
+                              CellSet* captures, CellSet* escapes) {
+  captures->Clear();
+  escapes->Clear();
+  Start(board, max_nodes);
+  // One stone of every chain worth reading, taken before the scratch board
+  // changes.
+  std::vector<Index> targets;
+  const GoColor player = board.current_player();
+  board.ForEachChain([player, &targets](const typename Board::Chain& chain) {
+    const int num_liberties = chain.liberties.Count();
+    if (num_liberties == 1 || (num_liberties == 2 && chain.color != player)) {
+      targets.push_back(chain.stones.First());
+    }
+  });
+  for (const Index target : targets) {
+    if (out_of_nodes_) break;
+    const bool own = (scratch_->StoneAt(target) == player);
+    CellSet moves = own ? EscapeMoves(target)
+                        : scratch_->GetChain(target)->liberties;
+    moves.AndNot(own ? *escapes : *captures);
+    while (!moves.Empty()) {
+      const Index move = moves.First();
+      moves.Reset(move);
+      const bool works = own ? EscapesWith(target, move)
+                             : CapturesWith(target, move);
+      // A result read with the budget spent may be wrong, so it is dropped.
+      if (out_of_nodes_) break;
+      if (works) (own ? escapes : captures)->Set(move);
+    }
+  }
+}
+
+template <int N>
+TacticalStatus TacticalReaderT<N>::ReadChain(const Board& board, Index idx,
+                                             int max_nodes) {
+  const typename Board::Chain* chain = board.GetChain(idx);
+  CHECK(chain != nullptr) << "No chain on " << ToString(board.FromIndex(idx));
+  const int num_liberties = chain->liberties.Count();
+  const bool own = (chain->color == board.current_player());
+  if (num_liberties >= 3 || (own && num_liberties == 2)) {
+    num_nodes_ = 0;
+    return TACTICS_SAFE;
+  }
+  Start(board, max_nodes);
+  const bool captured = own ? !CanEscape(idx) : CanCapture(idx);
+  if (out_of_nodes_) return TACTICS_UNKNOWN;
+  return captured ? TACTICS_CAPTURED : TACTICS_SAFE;
+}
+
+template class TacticalReaderT<0>;
+template class TacticalReaderT<9>;
+template class TacticalReaderT<13>;
+template class TacticalReaderT<19>;
+
+}  // namespace zebra_go
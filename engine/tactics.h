@@ -0,0 +1,90 @@
+#ifndef ZEBRA_GO_ENGINE_TACTICS_H_
+#define ZEBRA_GO_ENGINE_TACTICS_H_
+
+#include <memory>
+#include <vector>
+
+#include "engine/go_game.h"
+
+namespace zebra_go {
+
+// Reads ladders and one-move captures on a GoBoardT<N>. It plays and takes
+// back moves on a scratch copy of the board, so a read costs one memcpy plus
+// one Play and one Undo per node, and leaves the board it was given alone.
+//
+// Only chains with at most two liberties are read. The attacker keeps putting
+// the chain in atari, on either liberty; the defender extends on its last
+// liberty or captures a chain in atari next to it. The chain escapes once it
+// has three liberties. Every read is limited to a number of nodes, i.e. moves
+// played on the scratch board, so its cost per position has a bound; what is
+// left unread when the budget runs out is reported as unknown.
+template <int N>
+class TacticalReaderT {
+ public:
+  typedef GoBoardT<N> Board;
+  typedef typename Board::Index Index;
+  typedef typename Board::CellSet CellSet;
+
+  TacticalReaderT() {}
+
+  // Finds, for current player of "board", the moves that capture an opponent
+  // chain, at once or in a ladder, and the moves that save a chain of current
+  // player in atari from being captured. At most "max_nodes" nodes are read
+  // in total; chains read after the budget runs out get no moves.
+  void Read(const Board& board, int max_nodes, CellSet* captures,
+            CellSet* escapes);
+
+  // Reads the chain on "idx" with current player to move, within
+  // "max_nodes" nodes. The chain is captured if current player can capture
+  // it, for an opponent chain, or can't save it, for an own chain in atari.
+  TacticalStatus ReadChain(const Board& board, Index idx, int max_nodes);
+
+  // Number of nodes read by the last Read or ReadChain.
+  int num_nodes() const { return num_nodes_; }
+
+ private:
+  // Copies "board" into the scratch board and resets the budget.
+  void Start(const Board& board, int max_nodes);
+
+  // Plays a legal move on the scratch board. Returns false, and plays
+  // nothing, if the budget is spent.
+  bool Play(Index idx);
+  void Undo();
+
+  // Whether current player of the scratch board can capture the opponent
+  // chain on "target", which has at most two liberties.
+  bool CanCapture(Index target);
+
+  // Whether current player of the scratch board can save its chain on
+  // "target", which is in atari.
+  bool CanEscape(Index target);
+
+  // Whether current player saves its chain on "target" by playing "move".
+  bool EscapesWith(Index target, Index move);
+
+  // Whether current player captures the opponent chain on "target" by
+  // playing "move", a liberty of the chain.
+  bool CapturesWith(Index target, Index move);
+
+  // The moves that may save the chain in atari on "target": its liberty and
+  // the liberties of the opponent chains in atari next to it.
+  CellSet EscapeMoves(Index target) const;
+
+  std::unique_ptr<Board> scratch_;
+  std::vector<typename Board::UndoRecord> undo_stack_;
+  int depth_ = 0;
+  int nodes_left_ = 0;
+  int num_nodes_ = 0;
+  // Set when Play refused a move because the budget was spent.
+  bool out_of_nodes_ = false;
+  CellSet captured_;
+};
+
+extern template class TacticalReaderT<0>;
+extern template class TacticalReaderT<9>;
+extern template class TacticalReaderT<13>;
+extern template class TacticalReaderT<19>;
+
+}  // namespace zebra_go
+
+#endif  // ZEBRA_GO_ENGINE_TACTICS_H_
@@ -0,0 +1,104 @@
+#include "engine/tactics.h"
+
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+
+namespace zebra_go {
+namespace {
+
+// Plays the stones of each color, with the other color passing, so that
+// "to_move" plays next.
+void PlaceStones(GoBoard* board, const std::vector<GoPosition>& black,
+                 const std::vector<GoPosition>& white, GoColor to_move) {
+  for (const GoPosition& pos : black) {
+    ASSERT_TRUE(board->Move(pos, nullptr));
+    ASSERT_TRUE(board->Move(kMovePass, nullptr));
+  }
+  for (const GoPosition& pos : white) {
+    ASSERT_TRUE(board->Move(kMovePass, nullptr));
+    ASSERT_TRUE(board->Move(pos, nullptr));
+  }
+  if (board->current_player() != to_move) {
+    ASSERT_TRUE(board->Move(kMovePass, nullptr));
+  }
+}
+
+// A white stone on C3 with two liberties, C4 and D3. Black at C4 starts a
+// ladder that runs to the upper right; black at D3 lets white out on C4.
+const std::vector<GoPosition> kLadderBlack = {{1, 2}, {2, 1}, {3, 1}};
+const std::vector<GoPosition> kLadderWhite = {{2, 2}};
+
+TEST(TacticsTest, Ladder) {
+  GoBoard board(9);
+  PlaceStones(&board, kLadderBlack, kLadderWhite, COLOR_BLACK);
+  std::vector<uint8_t> moves;
+  board.ReadTactics(1000, &moves);
+  EXPECT_EQ(kTacticalCapture, moves[board.Encode({2, 3})]);
+  EXPECT_EQ(0, moves[board.Encode({3, 2})]);
+  for (size_t i = 0; i < moves.size(); ++i) {
+    if (board.Decode(i) != GoPosition(2, 3)) {
+      EXPECT_EQ(0, moves[i]) << i;
+    }
+  }
+  EXPECT_EQ(TACTICS_CAPTURED, board.ReadChain({2, 2}, 1000));
+}
+
+TEST(TacticsTest, LadderBreaker) {
+  GoBoard board(9);
+  std::vector<GoPosition> white = kLadderWhite;
+  white.push_back({6, 6});
+  PlaceStones(&board, kLadderBlack, white, COLOR_BLACK);
+  std::vector<uint8_t> moves;
+  board.ReadTactics(1000, &moves);
+  EXPECT_EQ(0, moves[board.Encode({2, 3})]);
+  EXPECT_EQ(TACTICS_SAFE, board.ReadChain({2, 2}, 1000));
+}
+
+TEST(TacticsTest, Escape) {
+  // White in atari on C3, with its last liberty on C4.
+  GoBoard board(9);
+  std::vector<GoPosition> black = kLadderBlack;
+  black.push_back({3, 2});
+  PlaceStones(&board, black, kLadderWhite, COLOR_WHITE);
+  std::vector<uint8_t> moves;
+  board.ReadTactics(1000, &moves);
+  EXPECT_EQ(kTacticalEscape, moves[board.Encode({2, 3})]);
+  EXPECT_EQ(TACTICS_SAFE, board.ReadChain({2, 2}, 1000));
+  EXPECT_EQ(TACTICS_SAFE, board.ReadChain({3, 2}, 1000));
+
+  // In atari on D3 instead, white runs into the ladder.
+  GoBoard ladder(9);
+  black = kLadderBlack;
+  black.push_back({2, 3});
+  PlaceStones(&ladder, black, kLadderWhite, COLOR_WHITE);
+  ladder.ReadTactics(1000, &moves);
+  EXPECT_EQ(0, moves[ladder.Encode({3, 2})]);
+  EXPECT_EQ(TACTICS_CAPTURED, ladder.ReadChain({2, 2}, 1000));
+}
+
+TEST(TacticsTest, EscapeByCapture) {
+  // White in atari on B2 saves it by capturing the black stone on C2, which
+  // is in atari too.
+  GoBoard board(5);
+  PlaceStones(&board, {{0, 1}, {1, 2}, {2, 1}}, {{1, 1}, {3, 1}, {2, 2}},
+              COLOR_WHITE);
+  std::vector<uint8_t> moves;
+  board.ReadTactics(1000, &moves);
+  EXPECT_EQ(kTacticalEscape | kTacticalCapture, moves[board.Encode({2, 0})]);
+}
+
+TEST(TacticsTest, NodeBudget) {
+  GoBoard board(19);
+  PlaceStones(&board, kLadderBlack, kLadderWhite, COLOR_BLACK);
+  EXPECT_EQ(TACTICS_UNKNOWN, board.ReadChain({2, 2}, 5));
+  std::vector<uint8_t> moves;
+  board.ReadTactics(5, &moves);
+  EXPECT_EQ(0, moves[board.Encode({2, 3})]);
+  board.ReadTactics(1000, &moves);
+  EXPECT_EQ(kTacticalCapture, moves[board.Encode({2, 3})]);
+}
+
+}  // namespace
+}  // namespace zebra_go
@@ -109,7 +109,6 @@ class GtpServer {
     SIMPLE_HANDLER("name", "ZebraGo");
     SIMPLE_HANDLER("version", "0.1");
     SIMPLE_HANDLER("protocol_version", "2");
-    SIMPLE_HANDLER("final_score", "0");  // Actually not implemented.
 
 #undef SIMPLE_HANDLER
 
@@ -149,6 +148,20 @@ class GtpServer {
             return false;
           }
         });
+    RegisterHandler(
+        "final_score",
+        // Example output: "B+3.5", "W+0.5" or "0" for a draw.
+        [this](const std::vector<string>& args, string* output) -> bool {
+          const float score = engine_->FinalScore();
+          if (score > 0) {
+            *output = absl::StrCat("B+", score);
+          } else if (score < 0) {
+            *output = absl::StrCat("W+", -score);
+          } else {
+            *output = "0";
+          }
+          return true;
+        });
     RegisterHandler(
         "play",
         [this](const std::vector<string>& args, string* output) -> bool {
@@ -1,5 +1,7 @@
 #include "model/feature_converter.h"
 
+#include "engine/symmetry.h"
+
 namespace zebra_go {
 
 namespace tf = tensorflow;
@@ -8,6 +10,17 @@ tf::Tensor GoFeatureSetToTensor(const GoFeatureSet& features) {
   return BatchGoFeatureSetsToTensor({&features});
 }
 
+void CopyGoFeatureSetToTensor(const GoFeatureSet& features, int idx,
+                              tf::Tensor* tensor) {
+  CHECK_EQ(4, tensor->dims());
+  CHECK_EQ(features.height(), tensor->dim_size(1));
+  CHECK_EQ(features.width(), tensor->dim_size(2));
+  CHECK_EQ(features.num_planes(), tensor->dim_size(3));
+  CHECK(idx >= 0 && idx < tensor->dim_size(0));
+  features.ExpandTo(tensor->flat<float>().data() +
+                    idx * features.expanded_size());
+}
+
 tensorflow::Tensor BatchGoFeatureSetsToTensor(
     const std::vector<const GoFeatureSet*>& feature_batch) {
   CHECK(!feature_batch.empty());
@@ -17,18 +30,35 @@ tensorflow::Tensor BatchGoFeatureSetsToTensor(
   const auto num_channels = feature_batch[0]->num_planes();
   tf::TensorShape shape({num_examples, height, width, num_channels});
   tensorflow::Tensor result(tf::DT_FLOAT, shape);
-  auto tensor = result.tensor<float, 4>();
   for (int idx = 0; idx < num_examples; ++idx) {
-    CHECK_EQ(feature_batch[idx]->height(), height);
-    CHECK_EQ(feature_batch[idx]->width(), width);
+    CopyGoFeatureSetToTensor(*feature_batch[idx], idx, &result);
+  }
+  return result;
+}
+
+tensorflow::Tensor BatchGoFeatureSetsToTensorWithSymmetries(
+    const std::vector<const GoFeatureSet*>& feature_batch) {
+  CHECK(!feature_batch.empty());
+  const int num_examples = feature_batch.size();
+  const GoSizeT size = feature_batch[0]->width();
+  CHECK_EQ(feature_batch[0]->height(), size);
+  const auto num_channels = feature_batch[0]->num_planes();
+  tf::TensorShape shape(
+      {num_examples * kNumSymmetries, size, size, num_channels});
+  tensorflow::Tensor result(tf::DT_FLOAT, shape);
+  // With the same extra planes as the batch.
+  GoFeatureSet transformed(size, size,
+                           feature_batch[0]->has_tactical_planes(),
+                           feature_batch[0]->num_history());
+  for (int idx = 0; idx < num_examples; ++idx) {
+    CHECK_EQ(feature_batch[idx]->height(), size);
+    CHECK_EQ(feature_batch[idx]->width(), size);
     CHECK_EQ(feature_batch[idx]->num_planes(), num_channels);
-    for (int pid = 0; pid < num_channels; ++pid) {
-      const auto& plane = feature_batch[idx]->plane(pid);
-      for (GoSizeT y = 0; y < height; ++y) {
-        for (GoSizeT x = 0; x < width; ++x) {
-          tensor(idx, y, x, pid) = plane[y * width + x];
-        }
-      }
+    for (int s = 0; s < kNumSymmetries; ++s) {
+      ApplySymmetry(static_cast<Symmetry>(s), *feature_batch[idx],
+                    &transformed);
+      CopyGoFeatureSetToTensor(transformed, idx * kNumSymmetries + s,
+                               &result);
     }
   }
   return result;
@@ -77,10 +107,8 @@ bool GoFeatureSetToExample(GoPosition next_move, float outcome,
   // A shor note to help debugging.
   features["note"].mutable_bytes_list()->add_value(note);
 
-  // Encode all the planes.
-  const int feature_len = go_feature_set.width() * go_feature_set.height();
+  // Encode all the planes, each row by row.
   for (int pid = 0; pid < go_feature_set.num_planes(); ++pid) {
-    DCHECK_EQ(go_feature_set.plane(pid).size(), feature_len);
     auto& new_plane = features[go_feature_set.GetPlaneName(pid)];
     MakeFloatsFeature(go_feature_set.plane(pid), &new_plane);
   }
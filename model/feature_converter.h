@@ -15,6 +15,18 @@ tensorflow::Tensor GoFeatureSetToTensor(const GoFeatureSet& features);
 tensorflow::Tensor BatchGoFeatureSetsToTensor(
     const std::vector<const GoFeatureSet*>& batch_feature);
 
+// Copies "features" into example "idx" of a float batch tensor of shape
+// [batch, height, width, planes], expanding the packed cells to floats.
+void CopyGoFeatureSetToTensor(const GoFeatureSet& features, int idx,
+                              tensorflow::Tensor* tensor);
+
+// Like BatchGoFeatureSetsToTensor, but writes all kNumSymmetries transforms of
+// each feature set, so the batch size is kNumSymmetries times larger. Example
+// idx * kNumSymmetries + s holds feature set idx under Symmetry s. The boards
+// must be square.
+tensorflow::Tensor BatchGoFeatureSetsToTensorWithSymmetries(
+    const std::vector<const GoFeatureSet*>& batch_feature);
+
 // "Current player" is the one who is going to play the next move.
 // "outcome" is the final result of the game, positive if current player wins.
 // "note" is a short string that describes the example.
@@ -1,10 +1,13 @@
 #include "model/feature_converter.h"
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 #include "absl/memory/memory.h"
 #include "engine/go_game.h"
 #include "engine/sgf_utils.h"
+#include "engine/symmetry.h"
 #include "glog/logging.h"
 #include "gtest/gtest.h"
 
@@ -37,6 +40,25 @@ class FeatureConverterTest : public ::testing::Test {
       EXPECT_FLOAT_EQ(values.Get(i), expect_values[i]);
     }
   }
+  // Every symmetry of "features" is in the batch, all planes included.
+  void CheckSymmetries(const GoFeatureSet& features) {
+    auto tensor = BatchGoFeatureSetsToTensorWithSymmetries({&features});
+    ASSERT_EQ(4, tensor.dims());
+    EXPECT_EQ(kNumSymmetries, tensor.dim_size(0));
+    ASSERT_EQ(features.num_planes(), tensor.dim_size(3));
+    auto values = tensor.tensor<float, 4>();
+    for (int s = 0; s < kNumSymmetries; ++s) {
+      GoFeatureSet expected(5, 5, features.has_tactical_planes(),
+                            features.num_history());
+      ApplySymmetry(static_cast<Symmetry>(s), features, &expected);
+      for (int pid = 0; pid < expected.num_planes(); ++pid) {
+        for (int i = 0; i < 25; ++i) {
+          EXPECT_EQ(expected.plane(pid)[i], values(s, i / 5, i % 5, pid));
+        }
+      }
+    }
+  }
+
   std::unique_ptr<GoBoard> board_;
 };
 
@@ -49,6 +71,26 @@ TEST_F(FeatureConverterTest, ToTensor) {
   EXPECT_EQ(7, tensor.dim_size(3));  // number of planes
 }
 
+TEST_F(FeatureConverterTest, ToTensorWithSymmetries) {
+  CheckSymmetries(board_->GetFeatures());
+}
+
+TEST_F(FeatureConverterTest, ToTensorWithSymmetriesAndExtraPlanes) {
+  board_->EnableTacticalFeatures(/*max_nodes=*/1000);
+  board_->EnableHistoryFeatures(/*num_positions=*/2);
+  // One move, so that the history planes differ from the stones.
+  const std::vector<uint8_t>& legal_moves = board_->GetLegalMoves();
+  const auto first_legal =
+      std::find(legal_moves.begin(), legal_moves.end(), 1);
+  ASSERT_TRUE(first_legal != legal_moves.end());
+  ASSERT_TRUE(board_->Move(board_->Decode(first_legal - legal_moves.begin()),
+                           nullptr));
+  const GoFeatureSet& features = board_->GetFeatures();
+  ASSERT_TRUE(features.has_tactical_planes());
+  ASSERT_EQ(2, features.num_history());
+  CheckSymmetries(features);
+}
+
 TEST_F(FeatureConverterTest, ToExample) {
   tf::Example example;
   GoFeatureSetToExample({1, 4}, 2.5, board_->GetFeatures(), "test", &example);